@@ -2,11 +2,26 @@
 #include <random>
 #include <chrono>
 #include <cstdio>
+#include <cinttypes>
+#include <cstdlib>
+#include <numeric>
+
+#include <immintrin.h>
+#include <sys/wait.h>
 
 #include "polyset.h"
 #include "item_twine.h"
 #include "chunk_twine.h"
 #include "carousel.h"
+#include "epoch_twine.h"
+#include "parallel.h"
+#include "undo_log.h"
+#include "hierarchy.h"
+#include "replica_twine.h"
+#include "shm_twine.h"
+#include "partition.h"
+#include "ordered.h"
+#include "lookup.h"
 
 template<typename T>
 class Ops {
@@ -16,6 +31,7 @@ public:
     Assign(partition, SampleAssignCalls(kNumItems*10));
     Iterate(partition, SampleSubsets(kNumSubsets*100));
     Verify(partition);
+    VerifyParallel(partition);
   }
 
 private:
@@ -87,12 +103,96 @@ private:
     std::printf("Verify(): checksum=%u\n", checksum);
   }
 
+  // same checksum as Verify(), partial sums are collected per worker
+  void __attribute__((noinline)) VerifyParallel(const T& partition) {
+    int num_threads = std::max<int>(std::thread::hardware_concurrency(), 1);
+    std::vector<std::vector<uint32_t>> sums(num_threads, std::vector<uint32_t>(kNumSubsets, 0));
+
+    auto ts1 = std::chrono::high_resolution_clock::now();
+    ForEachSubsetParallel(partition, kNumSubsets, num_threads,
+      [&](int worker, int subset, const auto& slice) {
+        uint32_t sum = 0;
+        for (int item : slice) {
+          sum = sum + (uint32_t)item;
+        }
+        sums[worker][subset] += sum;
+      });
+    uint32_t checksum = 1;
+    for (int subset = 0; subset < kNumSubsets; subset++) {
+      checksum = checksum * 13;
+      for (int worker = 0; worker < num_threads; worker++) {
+        checksum = checksum + sums[worker][subset];
+      }
+    }
+    auto ts2 = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = ts2 - ts1;
+
+    std::printf("VerifyParallel(): %.3f sec | %d threads | checksum=%u\n",
+                elapsed.count(), num_threads, checksum);
+  }
+
 private:
   static constexpr int kNumItems = 1000000;
   static constexpr int kNumSubsets = 1000;
 };
 
 
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Random SubsetOf() calls on a map much larger than LLC: scalar lookups vs
+ * batched SubsetOfMany().
+ */
+template<typename T>
+class Lookups {
+public:
+  void Run() {
+    std::default_random_engine rng(31337);
+    std::uniform_int_distribution<int> item_dice(0, kNumLookupItems-1);
+    std::uniform_int_distribution<int> subset_dice(0, kNumSubsets-1);
+    std::vector<int> subset_of(kNumLookupItems);
+    for (int& subset : subset_of) {
+      subset = subset_dice(rng);
+    }
+    const T partition = T::FromAssignment(subset_of.data(), kNumLookupItems, kNumSubsets);
+
+    std::vector<int> items(kNumLookups);
+    for (int& item : items) {
+      item = item_dice(rng);
+    }
+    std::vector<int> out(kNumLookups);
+
+    auto ts1 = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < kNumLookups; i++) {
+      out[i] = partition.SubsetOf(items[i]);
+    }
+    auto ts2 = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = ts2 - ts1;
+    uint32_t checksum = std::accumulate(out.begin(), out.end(), uint32_t(0));
+    std::printf("SubsetOf(): %.3f sec | %.0f items/sec | checksum=%u\n",
+                elapsed.count(),
+                std::floor(kNumLookups/elapsed.count()),
+                checksum);
+
+    std::fill(out.begin(), out.end(), -1);
+    ts1 = std::chrono::high_resolution_clock::now();
+    SubsetOfMany(partition, items.data(), out.data(), kNumLookups);
+    ts2 = std::chrono::high_resolution_clock::now();
+    elapsed = ts2 - ts1;
+    checksum = std::accumulate(out.begin(), out.end(), uint32_t(0));
+    std::printf("SubsetOfMany(): %.3f sec | %.0f items/sec | checksum=%u\n",
+                elapsed.count(),
+                std::floor(kNumLookups/elapsed.count()),
+                checksum);
+  }
+
+private:
+  static constexpr int kNumSubsets = 1000;
+  static constexpr int kNumLookupItems = 10000000;
+  static constexpr int kNumLookups = 10000000;
+};
+
+
 ////////////////////////////////////////////////////////////////////////////////
 
 /*
@@ -201,10 +301,15 @@ private:
 
 ////////////////////////////////////////////////////////////////////////////////
 
-/* Naive implementation of good old K-means clustering */
+/*
+ * Naive implementation of good old K-means clustering. With num_threads > 1
+ * centers are recomputed by several threads over split subset views.
+ */
 template<typename T>
 class KMeans {
 public:
+  KMeans(int num_threads = 1) : num_threads_(num_threads) {}
+
   void Run() {
     constexpr int num_points = 1000000;
     constexpr int num_clusters = 5;
@@ -238,21 +343,36 @@ private:
     return points;
   }
 
+  int NearestCenter(double point, const std::vector<double>& centers) {
+    int best_c = 0;
+    double best_dist = std::fabs(point - centers[best_c]);
+    for (size_t c = 1; c < centers.size(); c++) {
+      double dist = std::fabs(point - centers[c]);
+      if (dist < best_dist) {
+        best_c = c;
+        best_dist = dist;
+      }
+    }
+    return best_c;
+  }
+
+  // initial distribution is computed in full and bulk-loaded into container
+  T DistributePoints(const std::vector<double>& points,
+                     const std::vector<double>& centers)
+  {
+    std::vector<int> cluster_of(points.size());
+    for (size_t p = 0; p < points.size(); p++) {
+      cluster_of[p] = NearestCenter(points[p], centers);
+    }
+    return T::FromAssignment(cluster_of.data(), points.size(), centers.size());
+  }
+
   void RedistributePoints(const std::vector<double>& points,
                           const std::vector<double>& centers,
                           T& clusters)
   {
     for (size_t p = 0; p < points.size(); p++) {
-      int best_c = 0;
-      double best_dist = std::fabs(points[p] - centers[best_c]);
-      for (size_t c = 1; c < centers.size(); c++) {
-        double dist = std::fabs(points[p] - centers[c]);
-        if (dist < best_dist) {
-          best_c = c;
-          best_dist = dist;
-        }
-      }
-      clusters.Assign(p, best_c);
+      clusters.Assign(p, NearestCenter(points[p], centers));
     }
   }
 
@@ -272,22 +392,266 @@ private:
     }
   }
 
+  void RecomputeCentersParallel(const std::vector<double>& points,
+                                const T& clusters,
+                                std::vector<double>& centers)
+  {
+    struct Partial {
+      double sum = 0.0;
+      int count = 0;
+    };
+    std::vector<std::vector<Partial>> partials(num_threads_, std::vector<Partial>(centers.size()));
+    ForEachSubsetParallel(clusters, centers.size(), num_threads_,
+      [&](int worker, int c, const auto& slice) {
+        Partial& partial = partials[worker][c];
+        for (int p : slice) {
+          partial.sum += points[p];
+          partial.count += 1;
+        }
+      });
+    for (size_t c = 0; c < centers.size(); c++) {
+      double mean = 0.0;
+      int count = 0;
+      for (int worker = 0; worker < num_threads_; worker++) {
+        mean += partials[worker][c].sum;
+        count += partials[worker][c].count;
+      }
+      centers[c] = mean/count;
+    }
+  }
+
+  void UpdateCenters(const std::vector<double>& points,
+                     const T& clusters,
+                     std::vector<double>& centers)
+  {
+    if (num_threads_ > 1) {
+      RecomputeCentersParallel(points, clusters, centers);
+    } else {
+      RecomputeCenters(points, clusters, centers);
+    }
+  }
+
   std::vector<double> __attribute__((noinline)) Clusterize(
       const std::vector<double>& points,
       int num_clusters, int iters)
   {
-    T clusters(points.size(), num_clusters);
     std::vector<double> centers(points.begin(), points.begin() + num_clusters);
-    for (int iter = 0; iter < iters; iter++) {
+    T clusters = DistributePoints(points, centers);
+    UpdateCenters(points, clusters, centers);
+    for (int iter = 1; iter < iters; iter++) {
+      RedistributePoints(points, centers, clusters);
+      UpdateCenters(points, clusters, centers);
+    }
+    return centers;
+  }
+
+  int num_threads_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/* Squared euclidean distance between two d-dimensional float vectors */
+float SquaredDistanceScalar(const float* a, const float* b, int dims) {
+  float dist = 0.0f;
+  for (int i = 0; i < dims; i++) {
+    float diff = a[i] - b[i];
+    dist += diff * diff;
+  }
+  return dist;
+}
+
+__attribute__((target("avx2,fma")))
+float SquaredDistanceAvx2(const float* a, const float* b, int dims) {
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 16 <= dims; i += 16) {
+    __m256 diff0 = _mm256_sub_ps(_mm256_loadu_ps(a + i),     _mm256_loadu_ps(b + i));
+    __m256 diff1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+    acc0 = _mm256_fmadd_ps(diff0, diff0, acc0);
+    acc1 = _mm256_fmadd_ps(diff1, diff1, acc1);
+  }
+  for (; i + 8 <= dims; i += 8) {
+    __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+    acc0 = _mm256_fmadd_ps(diff, diff, acc0);
+  }
+  // horizontal sum of 8 lanes
+  __m256 acc = _mm256_add_ps(acc0, acc1);
+  __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_movehdup_ps(sum));
+  float dist = _mm_cvtss_f32(sum);
+  for (; i < dims; i++) {
+    float diff = a[i] - b[i];
+    dist += diff * diff;
+  }
+  return dist;
+}
+
+typedef float (*SquaredDistanceFn)(const float*, const float*, int);
+
+SquaredDistanceFn PickSquaredDistance() {
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return SquaredDistanceAvx2;
+  }
+  return SquaredDistanceScalar;
+}
+
+/*
+ * K-means over d-dimensional float points stored in row-major order (one row
+ * per point). Unlike 1-D KMeans, every access to a point through the partition
+ * container reads a whole row of dims*4 bytes.
+ */
+template<typename T>
+class KMeansMD {
+public:
+  KMeansMD(int dims) :
+      dims_(dims),
+      distance_(PickSquaredDistance()) {}
+
+  void Run() {
+    constexpr int num_points = 200000;
+    constexpr int num_clusters = 16;
+    constexpr int iters = 20;
+
+    std::vector<float> points = SamplePoints(num_points, num_clusters);
+
+    auto ts1 = std::chrono::high_resolution_clock::now();
+    std::vector<float> centers = Clusterize(points, num_clusters, iters);
+    auto ts2 = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = ts2 - ts1;
+
+    std::printf("Dims: %d\n", dims_);
+    std::printf("Total time: %.3f sec\n", elapsed.count());
+    std::printf("Inertia: %.3f\n", Inertia(points, centers));
+  }
+
+private:
+  // points are scattered around num_blobs random centers
+  std::vector<float> SamplePoints(int num_points, int num_blobs) {
+    std::default_random_engine rng(7892);
+    std::uniform_real_distribution<float> center_dice(0.0f, 1.0f);
+    std::normal_distribution<float> noise_dice(0.0f, 0.05f);
+    std::uniform_int_distribution<int> blob_dice(0, num_blobs-1);
+
+    std::vector<float> blobs(size_t(num_blobs) * dims_);
+    for (float& x : blobs) {
+      x = center_dice(rng);
+    }
+    std::vector<float> points(size_t(num_points) * dims_);
+    for (int p = 0; p < num_points; p++) {
+      const float* blob = &blobs[size_t(blob_dice(rng)) * dims_];
+      for (int i = 0; i < dims_; i++) {
+        points[size_t(p) * dims_ + i] = blob[i] + noise_dice(rng);
+      }
+    }
+    return points;
+  }
+
+  int NumPoints(const std::vector<float>& points) const {
+    return points.size() / dims_;
+  }
+
+  int NearestCenter(const float* point, const std::vector<float>& centers) {
+    int num_centers = centers.size() / dims_;
+    int best_c = 0;
+    float best_dist = distance_(point, &centers[0], dims_);
+    for (int c = 1; c < num_centers; c++) {
+      float dist = distance_(point, &centers[size_t(c) * dims_], dims_);
+      if (dist < best_dist) {
+        best_c = c;
+        best_dist = dist;
+      }
+    }
+    return best_c;
+  }
+
+  T DistributePoints(const std::vector<float>& points,
+                     const std::vector<float>& centers)
+  {
+    std::vector<int> cluster_of(NumPoints(points));
+    for (int p = 0; p < NumPoints(points); p++) {
+      cluster_of[p] = NearestCenter(&points[size_t(p) * dims_], centers);
+    }
+    return T::FromAssignment(cluster_of.data(), NumPoints(points), centers.size() / dims_);
+  }
+
+  void RedistributePoints(const std::vector<float>& points,
+                          const std::vector<float>& centers,
+                          T& clusters)
+  {
+    for (int p = 0; p < NumPoints(points); p++) {
+      clusters.Assign(p, NearestCenter(&points[size_t(p) * dims_], centers));
+    }
+  }
+
+  void RecomputeCenters(const std::vector<float>& points,
+                        const T& clusters,
+                        std::vector<float>& centers)
+  {
+    int num_centers = centers.size() / dims_;
+    std::vector<double> mean(dims_);
+    for (int c = 0; c < num_centers; c++) {
+      std::fill(mean.begin(), mean.end(), 0.0);
+      int count = 0;
+      for (int p : clusters.ViewOf(c)) {
+        const float* point = &points[size_t(p) * dims_];
+        for (int i = 0; i < dims_; i++) {
+          mean[i] += point[i];
+        }
+        count += 1;
+      }
+      if (count == 0) {
+        continue; // keep center of an empty cluster where it is
+      }
+      for (int i = 0; i < dims_; i++) {
+        centers[size_t(c) * dims_ + i] = mean[i] / count;
+      }
+    }
+  }
+
+  double Inertia(const std::vector<float>& points, const std::vector<float>& centers) {
+    double inertia = 0.0;
+    for (int p = 0; p < NumPoints(points); p++) {
+      const float* point = &points[size_t(p) * dims_];
+      int c = NearestCenter(point, centers);
+      inertia += distance_(point, &centers[size_t(c) * dims_], dims_);
+    }
+    return inertia;
+  }
+
+  std::vector<float> __attribute__((noinline)) Clusterize(
+      const std::vector<float>& points,
+      int num_clusters, int iters)
+  {
+    std::vector<float> centers(points.begin(), points.begin() + size_t(num_clusters) * dims_);
+    T clusters = DistributePoints(points, centers);
+    RecomputeCenters(points, clusters, centers);
+    for (int iter = 1; iter < iters; iter++) {
       RedistributePoints(points, centers, clusters);
       RecomputeCenters(points, clusters, centers);
     }
     return centers;
   }
+
+  int dims_;
+  SquaredDistanceFn distance_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// shard sizes shared by Balancer, RackBalancer and ReplicaBalancer
+std::vector<int> SampleShardSizes(int num_shards) {
+  std::vector<int> shard_sizes;
+  shard_sizes.reserve(num_shards);
+  std::default_random_engine rng(77654);
+  std::uniform_int_distribution<int> dice(1, 5000);
+  for (int shard = 0; shard < num_shards; shard++) {
+    shard_sizes.push_back(dice(rng));
+  }
+  return shard_sizes;
+}
+
 /*
  * Find mapping of "data shards" to "servers" which equalizes per-server usage
  * as much as possible. Uses simple local random search.
@@ -300,10 +664,11 @@ public:
     constexpr int avg_shards_per_server = 100;
     std::vector<int> shard_sizes = SampleShardSizes(num_servers * avg_shards_per_server);
 
-    ShardMap shard_map(shard_sizes, num_servers);
+    std::vector<int> server_of(shard_sizes.size());
     for (int i = 0; i < (int)shard_sizes.size(); i++) {
-      shard_map.Assign(i, i%num_servers);
+      server_of[i] = i%num_servers;
     }
+    ShardMap shard_map(shard_sizes, num_servers, server_of);
 
     auto ts1 = std::chrono::high_resolution_clock::now();
     Balance(shard_map);
@@ -318,22 +683,43 @@ private:
   // mapping of shards to servers with tracking of per-server usage
   class ShardMap {
   public:
-    ShardMap(const std::vector<int>& shard_sizes, int num_servers) :
-      partition_(shard_sizes.size(), num_servers),
+    ShardMap(const std::vector<int>& shard_sizes, int num_servers,
+             const std::vector<int>& server_of) :
+      partition_(T::FromAssignment(server_of.data(), shard_sizes.size(), num_servers)),
       shard_sizes_(shard_sizes),
       server_usages_(num_servers, 0)
     {
+      for (int shard = 0; shard < (int)shard_sizes.size(); shard++) {
+        server_usages_[server_of[shard]] += shard_sizes[shard];
+      }
     }
 
     void Assign(int shard, int server) {
       int prev_server = partition_.SubsetOf(shard);
-      if (prev_server != -1) {
-        server_usages_[prev_server] -= shard_sizes_[shard];
+      if (usage_moves_.logging()) {
+        usage_moves_.Push(Move{shard, prev_server, server});
       }
-      server_usages_[server] += shard_sizes_[shard];
+      MoveUsage(shard, prev_server, server);
       partition_.Assign(shard, server);
     }
 
+    // trial moves: both the partition and server usages are restored by Rollback()
+    struct Savepoint {
+      int partition;
+      int usages;
+    };
+
+    Savepoint Save() {
+      return Savepoint{partition_.Savepoint(), usage_moves_.Savepoint()};
+    }
+
+    void Rollback(const Savepoint& savepoint) {
+      partition_.Rollback(savepoint.partition);
+      usage_moves_.Rollback(savepoint.usages, [this](const Move& move) {
+        MoveUsage(move.shard, move.server, move.prev_server);
+      });
+    }
+
     int UsageOf(int server) const { return server_usages_[server]; }
 
     const typename T::SubsetView ViewOf(int server) const { return partition_.ViewOf(server); }
@@ -341,22 +727,27 @@ private:
     int num_servers() const { return (int)server_usages_.size(); }
 
   private:
+    struct Move {
+      int shard;
+      int prev_server;
+      int server;
+    };
+
+    void MoveUsage(int shard, int prev_server, int server) {
+      if (prev_server != -1) {
+        server_usages_[prev_server] -= shard_sizes_[shard];
+      }
+      if (server != -1) {
+        server_usages_[server] += shard_sizes_[shard];
+      }
+    }
+
     T partition_;
     const std::vector<int>& shard_sizes_;
     std::vector<int> server_usages_;
+    MoveLog<Move> usage_moves_;
   };
 
-  std::vector<int> SampleShardSizes(int num_shards) const {
-    std::vector<int> shard_sizes;
-    shard_sizes.reserve(num_shards);
-    std::default_random_engine rng(77654);
-    std::uniform_int_distribution<int> dice(1, 5000);
-    for (int shard = 0; shard < num_shards; shard++) {
-      shard_sizes.push_back(dice(rng));
-    }
-    return shard_sizes;
-  }
-
   void Print(const ShardMap& shard_map) {
     int lo = 0;
     int hi = 0;
@@ -390,13 +781,14 @@ private:
 
     std::vector<int> shards(shard_map.ViewOf(src).begin(), shard_map.ViewOf(src).end());
     for (int shard : shards) {
+      auto savepoint = shard_map.Save();
       shard_map.Assign(shard, dst);
       int diff = shard_map.UsageOf(src) - shard_map.UsageOf(dst);
       if ((diff >= 0) && (diff < best_diff)) {
         best_diff = diff;
         best_shard = shard;
       }
-      shard_map.Assign(shard, src);
+      shard_map.Rollback(savepoint);
     }
 
     if (best_shard != -1) {
@@ -411,77 +803,1430 @@ private:
 
 ////////////////////////////////////////////////////////////////////////////////
 
-class Unit {
+/*
+ * Balancer for shard -> server -> rack placement. Servers are equalized as in
+ * Balancer, but a move between racks is accepted only if it does not increase
+ * the usage gap between the two racks. Server and rack usages are aggregates
+ * maintained by Hierarchy, so racks are never recomputed from their servers.
+ */
+template<typename T>
+class RackBalancer {
 public:
-  Unit(const std::string& bench_name,
-       const std::string& impl_name,
-       std::function<void()> runner) :
-    bench_name_(bench_name),
-    impl_name_(impl_name),
-    runner_(runner)
-  {
-  }
+  typedef Hierarchy<T> ShardMap;
 
-  const std::string& bench_name() const { return bench_name_; }
-  const std::string& impl_name() const { return impl_name_; }
-  std::function<void()> runner() const { return runner_; }
+  void Run() {
+    constexpr int num_racks = 10;
+    constexpr int num_servers = 100;
+    constexpr int avg_shards_per_server = 100;
+    std::vector<int> shard_sizes = SampleShardSizes(num_servers * avg_shards_per_server);
 
-private:
-  std::string bench_name_;
-  std::string impl_name_;
-  std::function<void()> runner_;
-};
+    // skewed start: squares modulo num_servers leave many servers empty
+    std::vector<int> server_of(shard_sizes.size());
+    for (int i = 0; i < (int)shard_sizes.size(); i++) {
+      server_of[i] = int64_t(i) * i % num_servers;
+    }
+    std::vector<int> rack_of(num_servers);
+    for (int server = 0; server < num_servers; server++) {
+      rack_of[server] = server % num_racks;
+    }
+    ShardMap shard_map(server_of.data(), shard_sizes.size(), num_servers,
+                       rack_of.data(), num_racks,
+                       shard_sizes.data());
 
-template<typename T>
-void Register(const std::string& impl_name, std::vector<Unit>& units) {
-  units.emplace_back(
-    "ops",
-    impl_name,
-    [](){Ops<T>().Run();}
-  );
-  units.emplace_back(
-    "layout",
-    impl_name,
-    [](){LayoutSolver<T>().Run();}
-  );
-  units.emplace_back(
-    "kmeans",
-    impl_name,
-    [](){KMeans<T>().Run();}
-  );
-  units.emplace_back(
-    "balancer",
-    impl_name,
-    [](){Balancer<T>().Run();}
-  );
-}
+    auto ts1 = std::chrono::high_resolution_clock::now();
+    Balance(shard_map);
+    auto ts2 = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = ts2 - ts1;
 
-int main(int argc, char* argv[]) {
-  ::setlinebuf(stdout);
+    std::printf("Total time: %.3f sec\n", elapsed.count());
+    Print(shard_map);
+  }
 
-  if (argc > 3) {
-    std::printf("Usage: %s [<bench> [<impl>]]\n", argv[0]);
-    return 1;
+private:
+  void Print(const ShardMap& shard_map) {
+    int lo = 0;
+    int hi = 0;
+    for (int server = 0; server < shard_map.num_subsets(); server++) {
+      if (shard_map.SubsetWeight(server) < shard_map.SubsetWeight(lo)) {
+        lo = server;
+      }
+      if (shard_map.SubsetWeight(server) > shard_map.SubsetWeight(hi)) {
+        hi = server;
+      }
+    }
+    std::printf("Lowest usage: %d (at %d)\n", shard_map.SubsetWeight(lo), lo);
+    std::printf("Highest usage: %d (at %d)\n", shard_map.SubsetWeight(hi), hi);
+
+    // rack usages are cross-checked against a walk over all shards of the rack
+    int rack_lo = 0;
+    int rack_hi = 0;
+    bool consistent = true;
+    for (int rack = 0; rack < shard_map.num_groups(); rack++) {
+      int usage = 0;
+      for (int shard : shard_map.GroupViewOf(rack)) {
+        usage += shard_map.WeightOf(shard);
+      }
+      consistent = consistent && (usage == shard_map.GroupWeight(rack));
+      if (shard_map.GroupWeight(rack) < shard_map.GroupWeight(rack_lo)) {
+        rack_lo = rack;
+      }
+      if (shard_map.GroupWeight(rack) > shard_map.GroupWeight(rack_hi)) {
+        rack_hi = rack;
+      }
+    }
+    std::printf("Lowest rack usage: %d (at %d)\n", shard_map.GroupWeight(rack_lo), rack_lo);
+    std::printf("Highest rack usage: %d (at %d)\n", shard_map.GroupWeight(rack_hi), rack_hi);
+    std::printf("Rack usages: %s\n", consistent ? "consistent" : "MISMATCH");
   }
-  std::string bench_name;
-  std::string impl_name;
-  if (argc > 1) {
-    bench_name = std::string(argv[1]);
-    if (argc > 2) {
-      impl_name = std::string(argv[2]);
+
+  void __attribute__((noinline)) Balance(ShardMap& shard_map) {
+    std::default_random_engine rng(49136);
+    std::uniform_int_distribution<int> dice(0, shard_map.num_subsets()-1);
+    for (int iter = 0; iter < 1000000; iter++) {
+      int src = dice(rng);
+      int dst = dice(rng);
+      if (shard_map.SubsetWeight(src) > shard_map.SubsetWeight(dst)) {
+        while (TryBalance(shard_map, src, dst));
+      }
     }
   }
 
-  std::vector<Unit> units;
-  Register<PolyRbSet>("PolyRbSet", units);
-  Register<PolyHashSet>("PolyHashSet", units);
-  Register<PolyHopscotchSet>("PolyHopscotchSet", units);
-  Register<ItemTwine>("ItemTwine", units);
-  Register<ChunkTwine<123>>("ChunkTwine", units);
-  Register<Carousel>("Carousel", units);
+  bool TryBalance(ShardMap& shard_map, int src, int dst) {
+    int gap = shard_map.SubsetWeight(src) - shard_map.SubsetWeight(dst);
+    int best_diff = gap;
+    int best_shard = -1;
 
-  if (!bench_name.empty()) {
-    units.erase(
+    int src_rack = shard_map.GroupOf(src);
+    int dst_rack = shard_map.GroupOf(dst);
+    int rack_gap = shard_map.GroupWeight(src_rack) - shard_map.GroupWeight(dst_rack);
+
+    for (int shard : shard_map.ViewOf(src)) {
+      int size = shard_map.WeightOf(shard);
+      int diff = gap - 2*size;
+      if ((diff < 0) || (diff >= best_diff)) {
+        continue;
+      }
+      if ((src_rack != dst_rack) && (std::abs(rack_gap - 2*size) > std::abs(rack_gap))) {
+        continue;
+      }
+      best_diff = diff;
+      best_shard = shard;
+    }
+
+    if (best_shard != -1) {
+      shard_map.AssignItem(best_shard, dst);
+      return true;
+    }
+
+    return false;
+  }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * One writer thread moves random items between subsets while reader threads
+ * iterate random subsets inside epoch read sections. Every snapshot a reader
+ * sees must hold distinct items that were assigned to the subset at some point:
+ * moves are sampled up front, so every item has a known list of subsets it
+ * ever belongs to.
+ */
+template<typename T>
+class ReadWhileWrite {
+public:
+  void Run() {
+    std::vector<int> subset_of = SampleAssignment();
+    std::vector<Call> calls = SampleAssignCalls();
+    RecordHistory(subset_of, calls);
+    T partition = T::FromAssignment(subset_of.data(), kNumItems, kNumSubsets, kNumReaders);
+
+    std::atomic<bool> done(false);
+    std::vector<int64_t> items_read(kNumReaders, 0);
+    std::vector<int64_t> errors(kNumReaders, 0);
+    std::vector<std::thread> readers;
+    for (int r = 0; r < kNumReaders; r++) {
+      readers.emplace_back([&, r]() {
+        Read(partition, r, done, &items_read[r], &errors[r]);
+      });
+    }
+
+    auto ts1 = std::chrono::high_resolution_clock::now();
+    Write(partition, calls);
+    auto ts2 = std::chrono::high_resolution_clock::now();
+    done.store(true);
+    for (std::thread& reader : readers) {
+      reader.join();
+    }
+    std::chrono::duration<double> elapsed = ts2 - ts1;
+
+    std::printf("Writer: %.3f sec | %.0f items/sec\n",
+                elapsed.count(),
+                std::floor(kNumAssigns/elapsed.count()));
+    std::printf("Readers: %d threads | %.0f items/sec | errors=%" PRId64 "\n",
+                kNumReaders,
+                std::floor(std::accumulate(items_read.begin(), items_read.end(), int64_t(0))/elapsed.count()),
+                std::accumulate(errors.begin(), errors.end(), int64_t(0)));
+  }
+
+private:
+  std::vector<int> SampleAssignment() {
+    std::default_random_engine rng(24741);
+    std::uniform_int_distribution<int> subset_dice(0, kNumSubsets-1);
+    std::vector<int> subset_of(kNumItems);
+    for (int& subset : subset_of) {
+      subset = subset_dice(rng);
+    }
+    return subset_of;
+  }
+
+  struct Call {
+    int item;
+    int subset;
+  };
+
+  std::vector<Call> SampleAssignCalls() {
+    std::default_random_engine rng(57301);
+    std::uniform_int_distribution<int> item_dice(0, kNumItems-1);
+    std::uniform_int_distribution<int> subset_dice(0, kNumSubsets-1);
+    std::vector<Call> calls(kNumAssigns);
+    for (Call& call : calls) {
+      call.item = item_dice(rng);
+      call.subset = subset_dice(rng);
+    }
+    return calls;
+  }
+
+  // subsets of item are history_[history_begin_[item] .. history_begin_[item+1])
+  void RecordHistory(const std::vector<int>& subset_of, const std::vector<Call>& calls) {
+    history_begin_.assign(kNumItems + 1, 0);
+    for (int item = 0; item < kNumItems; item++) {
+      history_begin_[item + 1]++;
+    }
+    for (const Call& call : calls) {
+      history_begin_[call.item + 1]++;
+    }
+    std::partial_sum(history_begin_.begin(), history_begin_.end(), history_begin_.begin());
+    history_.resize(history_begin_[kNumItems]);
+    std::vector<int> size(kNumItems, 0);
+    for (int item = 0; item < kNumItems; item++) {
+      history_[history_begin_[item] + size[item]++] = subset_of[item];
+    }
+    for (const Call& call : calls) {
+      history_[history_begin_[call.item] + size[call.item]++] = call.subset;
+    }
+  }
+
+  bool WasAssigned(int item, int subset) const {
+    return std::find(history_.begin() + history_begin_[item],
+                     history_.begin() + history_begin_[item + 1],
+                     subset) != history_.begin() + history_begin_[item + 1];
+  }
+
+  void __attribute__((noinline)) Write(T& partition, const std::vector<Call>& calls) {
+    for (const Call& call : calls) {
+      partition.Assign(call.item, call.subset);
+    }
+  }
+
+  void Read(const T& partition, int reader, const std::atomic<bool>& done,
+            int64_t* items_read, int64_t* errors)
+  {
+    std::default_random_engine rng(80956 + reader);
+    std::uniform_int_distribution<int> subset_dice(0, kNumSubsets-1);
+    std::vector<int> seen(kNumItems, -1); // last round in which item was seen
+    for (int round = 0; !done.load(std::memory_order_relaxed); round++) {
+      EpochDomain::ReadGuard guard(partition.epochs(), reader);
+      int subset = subset_dice(rng);
+      for (int item : partition.ViewOf(subset)) {
+        if ((item < 0) || (item >= kNumItems) || (seen[item] == round) || !WasAssigned(item, subset)) {
+          (*errors)++;
+          continue;
+        }
+        seen[item] = round;
+        (*items_read)++;
+      }
+    }
+  }
+
+  static constexpr int kNumItems = 1000000;
+  static constexpr int kNumSubsets = 1000;
+  static constexpr int kNumReaders = 4;
+  static constexpr int kNumAssigns = 2000000;
+
+  std::vector<int> history_begin_;
+  std::vector<int> history_;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Balancer for replicated shards: every shard has kNumReplicas replicas on
+ * distinct servers, and a replica may only move to a server which does not
+ * hold the same shard yet. T is a multi-membership container.
+ */
+template<typename T>
+class ReplicaBalancer {
+public:
+  void Run() {
+    std::vector<int> shard_sizes = SampleShardSizes(kNumServers * kAvgShardsPerServer);
+    int num_shards = shard_sizes.size();
+
+    T partition(num_shards, kNumServers);
+    std::vector<int> server_usages(kNumServers, 0);
+    for (int shard = 0; shard < num_shards; shard++) {
+      for (int r = 0; r < kNumReplicas; r++) {
+        int server = (shard + r * kReplicaStride) % kNumServers;
+        partition.AddReplica(shard, server);
+        server_usages[server] += shard_sizes[shard];
+      }
+    }
+
+    auto ts1 = std::chrono::high_resolution_clock::now();
+    Balance(partition, shard_sizes, server_usages);
+    auto ts2 = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = ts2 - ts1;
+
+    std::printf("Total time: %.3f sec\n", elapsed.count());
+    Print(partition, num_shards, server_usages);
+  }
+
+private:
+  void Print(const T& partition, int num_shards, const std::vector<int>& server_usages) {
+    int lo = 0;
+    int hi = 0;
+    for (int server = 0; server < kNumServers; server++) {
+      if (server_usages[server] < server_usages[lo]) {
+        lo = server;
+      }
+      if (server_usages[server] > server_usages[hi]) {
+        hi = server;
+      }
+    }
+    std::printf("Lowest usage: %d (at %d)\n", server_usages[lo], lo);
+    std::printf("Highest usage: %d (at %d)\n", server_usages[hi], hi);
+
+    // every shard must still have all of its replicas, each on its own server
+    int64_t num_replicas = 0;
+    for (int server = 0; server < kNumServers; server++) {
+      for (int shard : partition.ViewOf(server)) {
+        num_replicas += partition.IsMember(shard, server) ? 1 : 0;
+      }
+    }
+    bool complete = (num_replicas == int64_t(num_shards) * kNumReplicas);
+    for (int shard = 0; shard < num_shards; shard++) {
+      complete = complete && (partition.NumReplicas(shard) == kNumReplicas);
+    }
+    std::printf("Replicas: %s\n", complete ? "complete" : "BROKEN");
+  }
+
+  void __attribute__((noinline)) Balance(T& partition,
+                                         const std::vector<int>& shard_sizes,
+                                         std::vector<int>& server_usages)
+  {
+    std::default_random_engine rng(49136);
+    std::uniform_int_distribution<int> dice(0, kNumServers-1);
+    for (int iter = 0; iter < 1000000; iter++) {
+      int src = dice(rng);
+      int dst = dice(rng);
+      if (server_usages[src] > server_usages[dst]) {
+        while (TryBalance(partition, shard_sizes, server_usages, src, dst));
+      }
+    }
+  }
+
+  bool TryBalance(T& partition, const std::vector<int>& shard_sizes,
+                  std::vector<int>& server_usages, int src, int dst)
+  {
+    int gap = server_usages[src] - server_usages[dst];
+    int best_diff = gap;
+    int best_shard = -1;
+
+    for (int shard : partition.ViewOf(src)) {
+      int diff = gap - 2*shard_sizes[shard];
+      if ((diff >= 0) && (diff < best_diff) && !partition.IsMember(shard, dst)) {
+        best_diff = diff;
+        best_shard = shard;
+      }
+    }
+
+    if (best_shard != -1) {
+      partition.MoveReplica(best_shard, src, dst);
+      server_usages[src] -= shard_sizes[best_shard];
+      server_usages[dst] += shard_sizes[best_shard];
+      return true;
+    }
+
+    return false;
+  }
+
+  static constexpr int kNumReplicas = 3;
+  static constexpr int kReplicaStride = 33; // initial replicas land on distinct servers
+  static constexpr int kNumServers = 100;
+  static constexpr int kAvgShardsPerServer = 100;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * One writer process keeps moving random items of a large map which lives in
+ * a shared memory region, while forked reader processes attach to the region,
+ * look up random items and take consistent copies of random subsets.
+ */
+template<typename T>
+class SharedReaders {
+public:
+  void Run() {
+    std::vector<int> subset_of = SampleAssignment();
+    T partition = T::FromAssignment(subset_of.data(), kNumItems, kNumSubsets);
+    subset_of = std::vector<int>();
+
+    // per-reader results are passed back through an anonymous shared mapping
+    void* mem = ::mmap(nullptr, sizeof(Results), PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+      std::perror("mmap");
+      return;
+    }
+    Results* results = new (mem) Results();
+
+    pid_t writer = ::getpid();
+    std::vector<pid_t> pids;
+    for (int r = 0; r < kNumReaders; r++) {
+      pid_t pid = ::fork();
+      if (pid < 0) {
+        std::perror("fork");
+        break;
+      }
+      if (pid == 0) {
+        Read(partition.fd(), r, writer, results);
+        ::_exit(0);
+      }
+      pids.push_back(pid);
+    }
+    int num_readers = pids.size();
+
+    // a reader which exits before it is released has crashed; stop waiting for it
+    std::default_random_engine rng(52011);
+    std::uniform_int_distribution<int> item_dice(0, kNumItems-1);
+    std::uniform_int_distribution<int> subset_dice(0, kNumSubsets-1);
+    int64_t num_assigns = 0;
+    int num_failed = 0;
+    std::vector<bool> exited(num_readers, false);
+    auto ts1 = std::chrono::high_resolution_clock::now();
+    while (results->num_done.load() < num_readers - num_failed) {
+      for (int i = 0; i < 1000; i++) {
+        partition.Assign(item_dice(rng), subset_dice(rng));
+      }
+      num_assigns += 1000;
+      for (int r = 0; r < num_readers; r++) {
+        if (!exited[r] && (::waitpid(pids[r], nullptr, WNOHANG) == pids[r])) {
+          exited[r] = true;
+          num_failed++;
+        }
+      }
+    }
+    auto ts2 = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = ts2 - ts1;
+
+    // all readers still map the region, so its pages are split between all processes
+    int64_t writer_pss = PssKb(writer);
+    int64_t readers_pss = 0;
+    for (int r = 0; r < num_readers; r++) {
+      if (!exited[r]) {
+        readers_pss += std::max<int64_t>(PssKb(pids[r]), 0);
+      }
+    }
+    results->released.store(true);
+    for (int r = 0; r < num_readers; r++) {
+      if (!exited[r]) {
+        ::waitpid(pids[r], nullptr, 0);
+      }
+    }
+
+    std::printf("Writer: %.3f sec | %.0f assigns/sec\n",
+                elapsed.count(), std::floor(num_assigns/elapsed.count()));
+    int64_t num_lookups = 0;
+    int64_t num_snapshots = 0;
+    for (int r = 0; r < num_readers; r++) {
+      num_lookups += results->readers[r].num_lookups;
+      num_snapshots += results->readers[r].num_snapshots;
+    }
+    std::printf("Readers: %d (%d failed) | %.0f lookups/sec | %.0f snapshots/sec\n",
+                num_readers, num_failed,
+                std::floor(num_lookups/kReadSeconds),
+                std::floor(num_snapshots/kReadSeconds));
+    std::printf("Memory: region %.1f MB | PSS writer %.1f MB, readers %.1f MB\n",
+                partition.region_size() / 1048576.0,
+                writer_pss / 1024.0, readers_pss / 1024.0);
+    ::munmap(mem, sizeof(Results));
+  }
+
+private:
+  static constexpr int kNumItems = 20000000;
+  static constexpr int kNumSubsets = 1000;
+  static constexpr int kNumReaders = 4;
+  static constexpr double kReadSeconds = 2.0;
+
+  struct ReaderResult {
+    int64_t num_lookups;
+    int64_t num_snapshots;
+  };
+
+  struct Results {
+    std::atomic<int> num_done{0};
+    std::atomic<bool> released{false}; // writer has measured PSS, readers may exit
+    ReaderResult readers[kNumReaders];
+  };
+
+  // proportional set size of process from /proc/<pid>/smaps_rollup, -1 if unavailable
+  static int64_t PssKb(pid_t pid) {
+    std::string path = "/proc/" + std::to_string(pid) + "/smaps_rollup";
+    FILE* file = std::fopen(path.c_str(), "r");
+    if (!file) {
+      return -1;
+    }
+    int64_t pss = -1;
+    char line[256];
+    while (std::fgets(line, sizeof(line), file)) {
+      long long kb;
+      if (std::sscanf(line, "Pss: %lld kB", &kb) == 1) {
+        pss = kb;
+        break;
+      }
+    }
+    std::fclose(file);
+    return pss;
+  }
+
+  std::vector<int> SampleAssignment() const {
+    std::default_random_engine rng(6312);
+    std::uniform_int_distribution<int> subset_dice(0, kNumSubsets-1);
+    std::vector<int> subset_of(kNumItems);
+    for (int& subset : subset_of) {
+      subset = subset_dice(rng);
+    }
+    return subset_of;
+  }
+
+  /*
+   * Reader process: batches of lookups interleaved with one subset copy.
+   * Keeps the region mapped until the writer has measured PSS, or until the
+   * writer is gone.
+   */
+  static void Read(int fd, int reader, pid_t writer, Results* results) {
+    const T partition(fd);
+    std::default_random_engine rng(reader);
+    std::uniform_int_distribution<int> item_dice(0, kNumItems-1);
+    std::uniform_int_distribution<int> subset_dice(0, kNumSubsets-1);
+    std::vector<int> items;
+    ReaderResult result{0, 0};
+    uint32_t checksum = 0;
+    auto ts1 = std::chrono::high_resolution_clock::now();
+    for (;;) {
+      for (int i = 0; i < 1000; i++) {
+        checksum += partition.SubsetOf(item_dice(rng));
+      }
+      result.num_lookups += 1000;
+      partition.SnapshotOf(subset_dice(rng), items);
+      checksum += items.size();
+      result.num_snapshots += 1;
+      std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - ts1;
+      if (elapsed.count() >= kReadSeconds) {
+        break;
+      }
+    }
+    asm volatile("" : : "r"(checksum));
+    results->readers[reader] = result;
+    results->num_done.fetch_add(1);
+    while (!results->released.load() && (::getppid() == writer)) {
+      ::usleep(1000);
+    }
+  }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Long uniform churn scatters chunk lists over the pool. Iteration throughput
+ * is measured on a freshly loaded partition, after the churn and after
+ * Compact().
+ */
+template<typename T>
+class Churn {
+public:
+  void Run() {
+    std::default_random_engine rng(90417);
+    std::uniform_int_distribution<int> item_dice(0, kNumItems-1);
+    std::uniform_int_distribution<int> subset_dice(0, kNumSubsets-1);
+    std::vector<int> subset_of(kNumItems);
+    for (int& subset : subset_of) {
+      subset = subset_dice(rng);
+    }
+    T partition = T::FromAssignment(subset_of.data(), kNumItems, kNumSubsets);
+    Iterate(partition, "fresh");
+
+    auto ts1 = std::chrono::high_resolution_clock::now();
+    for (int64_t i = 0; i < kNumMoves; i++) {
+      partition.Assign(item_dice(rng), subset_dice(rng));
+    }
+    auto ts2 = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = ts2 - ts1;
+    std::printf("Churn: %.3f sec | %.0f items/sec\n",
+                elapsed.count(), std::floor(kNumMoves/elapsed.count()));
+    Iterate(partition, "churned");
+
+    ts1 = std::chrono::high_resolution_clock::now();
+    partition.Compact();
+    ts2 = std::chrono::high_resolution_clock::now();
+    elapsed = ts2 - ts1;
+    std::printf("Compact(): %.3f sec\n", elapsed.count());
+    Iterate(partition, "compacted");
+  }
+
+private:
+  void __attribute__((noinline)) Iterate(const T& partition, const char* state) {
+    uint32_t checksum = 1;
+    int64_t num_items = 0;
+    auto ts1 = std::chrono::high_resolution_clock::now();
+    for (int pass = 0; pass < kNumPasses; pass++) {
+      for (int subset = 0; subset < kNumSubsets; subset++) {
+        checksum = checksum * 13;
+        for (int item : partition.ViewOf(subset)) {
+          checksum = checksum + (uint32_t)item;
+          num_items++;
+        }
+      }
+    }
+    auto ts2 = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = ts2 - ts1;
+    std::printf("Iterate(%s): %.3f sec | %.0f items/sec | checksum=%u\n",
+                state, elapsed.count(), std::floor(num_items/elapsed.count()), checksum);
+  }
+
+  static constexpr int kNumItems = 10000000;
+  static constexpr int kNumSubsets = 1000;
+  static constexpr int64_t kNumMoves = 100000000;
+  static constexpr int kNumPasses = 10;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Multilevel k-way partitioning of a weighted graph of shards, edge weights
+ * being traffic between shards. The graph is coarsened by heavy-edge
+ * matching, the coarsest graph is split by greedy region growing, and every
+ * level on the way back is refined by Fiduccia-Mattheyses passes.
+ *
+ * A pass keeps boundary nodes in gain buckets, a container of type T whose
+ * subsets are gain values, and repeatedly moves a node from the highest
+ * bucket, negative gains included; a node whose gain turns out to be stale
+ * is put back into the right bucket instead. The node -> part container is then rolled
+ * back to the lowest cut seen during the pass.
+ */
+template<typename T>
+class GraphPartitioner {
+public:
+  void Run() {
+    for (int num_nodes : {10000, 100000, 1000000}) {
+      Graph graph = GeneratePowerLaw(num_nodes);
+      int num_levels = 0;
+      auto ts1 = std::chrono::high_resolution_clock::now();
+      std::vector<int> part_of = RunMultilevel(graph, num_levels);
+      auto ts2 = std::chrono::high_resolution_clock::now();
+      std::chrono::duration<double> elapsed = ts2 - ts1;
+
+      std::default_random_engine rng(num_nodes);
+      std::uniform_int_distribution<int> part_dice(0, kNumParts-1);
+      std::vector<int> random_part_of(num_nodes);
+      for (int& part : random_part_of) {
+        part = part_dice(rng);
+      }
+      std::printf("Nodes: %d | Edges: %d | Levels: %d | Time: %.3f sec | "
+                  "Edge-cut: %" PRId64 " (random %" PRId64 ") | Imbalance: %.3f\n",
+                  num_nodes, graph.num_edges(), num_levels, elapsed.count(),
+                  CutOf(graph, part_of), CutOf(graph, random_part_of),
+                  ImbalanceOf(graph, part_of));
+    }
+  }
+
+private:
+  static constexpr int kNumParts = 32;
+  static constexpr double kMaxImbalance = 1.03; // heaviest part / average part
+  static constexpr int kCoarsestNodesPerPart = 30;
+  static constexpr int kEdgesPerNode = 4;
+  static constexpr double kLocality = 0.8; // share of edges to recent nodes
+  static constexpr int kLocalityWindow = 1000;
+  static constexpr int kMaxEdgeWeight = 100;
+  static constexpr int kMaxGain = 1000; // gains are clamped to [-kMaxGain, kMaxGain]
+  static constexpr int kNumBuckets = 2*kMaxGain + 1;
+  static constexpr int kMaxPasses = 8;
+  static constexpr int kMaxFruitlessMoves = 100; // moves past the best cut before a pass ends
+  // gains of nodes with more edges are not updated when a neighbour moves,
+  // but are rechecked when the node comes out of its bucket
+  static constexpr int kMaxUpdateDegree = 64;
+
+  // undirected graph in CSR form, every edge is stored in both directions
+  struct Graph {
+    int num_nodes() const { return node_weights.size(); }
+    int num_edges() const { return adj.size() / 2; }
+
+    std::vector<int> offsets; // edges of v are [offsets[v], offsets[v+1])
+    std::vector<int> adj;
+    std::vector<int> edge_weights;
+    std::vector<int> node_weights;
+  };
+
+  // mapping of nodes to parts with tracking of part weights
+  class PartMap {
+  public:
+    PartMap(const Graph& graph, const std::vector<int>& part_of) :
+      partition_(T::FromAssignment(part_of.data(), graph.num_nodes(), kNumParts)),
+      node_weights_(graph.node_weights),
+      part_weights_(kNumParts, 0)
+    {
+      for (int v = 0; v < graph.num_nodes(); v++) {
+        part_weights_[part_of[v]] += node_weights_[v];
+      }
+    }
+
+    void Assign(int v, int part) {
+      int prev_part = partition_.SubsetOf(v);
+      if (weight_moves_.logging()) {
+        weight_moves_.Push(Move{v, prev_part, part});
+      }
+      MoveWeight(v, prev_part, part);
+      partition_.Assign(v, part);
+    }
+
+    // moves since the savepoint are either rolled back or kept by Release()
+    struct Savepoint {
+      int partition;
+      int weights;
+    };
+
+    Savepoint Save() {
+      return Savepoint{partition_.Savepoint(), weight_moves_.Savepoint()};
+    }
+
+    void Rollback(const Savepoint& savepoint) {
+      partition_.Rollback(savepoint.partition);
+      weight_moves_.Rollback(savepoint.weights, [this](const Move& move) {
+        MoveWeight(move.v, move.part, move.prev_part);
+      });
+    }
+
+    void Release(const Savepoint& savepoint) {
+      partition_.Release(savepoint.partition);
+      weight_moves_.Release(savepoint.weights);
+    }
+
+    int PartOf(int v) const { return partition_.SubsetOf(v); }
+
+    int64_t WeightOf(int part) const { return part_weights_[part]; }
+
+  private:
+    struct Move {
+      int v;
+      int prev_part;
+      int part;
+    };
+
+    void MoveWeight(int v, int prev_part, int part) {
+      part_weights_[prev_part] -= node_weights_[v];
+      part_weights_[part] += node_weights_[v];
+    }
+
+    T partition_;
+    const std::vector<int>& node_weights_;
+    std::vector<int64_t> part_weights_;
+    MoveLog<Move> weight_moves_;
+  };
+
+  struct Move {
+    int part; // -1 if there is no move
+    int64_t gain;
+  };
+
+  /*
+   * Every new node links to kEdgesPerNode earlier nodes: either to an endpoint
+   * of a random earlier edge, which gives power-law degrees by preferential
+   * attachment, or to one of kLocalityWindow most recent nodes, which gives
+   * the graph a structure worth partitioning. Parallel edges are kept.
+   */
+  Graph GeneratePowerLaw(int num_nodes) const {
+    std::default_random_engine rng(3170 + num_nodes);
+    std::uniform_real_distribution<double> coin(0.0, 1.0);
+    std::uniform_int_distribution<int> weight_dice(1, kMaxEdgeWeight);
+    std::vector<std::pair<int, int>> edges;
+    std::vector<int> endpoints;
+    for (int v = 1; v < num_nodes; v++) {
+      for (int e = 0; e < std::min(v, kEdgesPerNode); e++) {
+        int u;
+        if (endpoints.empty() || (coin(rng) < kLocality)) {
+          u = std::uniform_int_distribution<int>(std::max(0, v - kLocalityWindow), v - 1)(rng);
+        } else {
+          u = endpoints[std::uniform_int_distribution<int>(0, endpoints.size() - 1)(rng)];
+        }
+        edges.emplace_back(u, v);
+        endpoints.push_back(u);
+        endpoints.push_back(v);
+      }
+    }
+
+    Graph graph;
+    graph.node_weights.assign(num_nodes, 1);
+    graph.offsets.assign(num_nodes + 1, 0);
+    for (const auto& edge : edges) {
+      graph.offsets[edge.first + 1]++;
+      graph.offsets[edge.second + 1]++;
+    }
+    std::partial_sum(graph.offsets.begin(), graph.offsets.end(), graph.offsets.begin());
+    graph.adj.resize(graph.offsets.back());
+    graph.edge_weights.resize(graph.offsets.back());
+    std::vector<int> cursor(graph.offsets.begin(), graph.offsets.end() - 1);
+    for (const auto& edge : edges) {
+      int weight = weight_dice(rng);
+      graph.adj[cursor[edge.first]] = edge.second;
+      graph.edge_weights[cursor[edge.first]++] = weight;
+      graph.adj[cursor[edge.second]] = edge.first;
+      graph.edge_weights[cursor[edge.second]++] = weight;
+    }
+    return graph;
+  }
+
+  std::vector<int> __attribute__((noinline)) RunMultilevel(const Graph& graph, int& num_levels) {
+    std::default_random_engine rng(60617);
+    int64_t total_weight = std::accumulate(graph.node_weights.begin(), graph.node_weights.end(), int64_t(0));
+    int max_node_weight = 1.5 * total_weight / (kCoarsestNodesPerPart * kNumParts);
+
+    // coarse_of[level][v]: node of level+1 that node v of level is merged into
+    std::vector<Graph> levels;
+    std::vector<std::vector<int>> coarse_of;
+    while (true) {
+      const Graph& fine = levels.empty() ? graph : levels.back();
+      if (fine.num_nodes() <= kCoarsestNodesPerPart * kNumParts) {
+        break;
+      }
+      std::vector<int> map;
+      Graph coarse = Coarsen(fine, max_node_weight, map, rng);
+      if (coarse.num_nodes() > 0.9 * fine.num_nodes()) {
+        break; // matching does not shrink the graph anymore
+      }
+      levels.push_back(std::move(coarse));
+      coarse_of.push_back(std::move(map));
+    }
+    num_levels = levels.size() + 1;
+
+    const Graph& coarsest = levels.empty() ? graph : levels.back();
+    std::vector<int> part_of = GrowRegions(coarsest, rng);
+    Refine(coarsest, part_of);
+    for (int level = (int)levels.size() - 1; level >= 0; level--) {
+      const Graph& fine = (level == 0) ? graph : levels[level - 1];
+      std::vector<int> fine_part_of(fine.num_nodes());
+      for (int v = 0; v < fine.num_nodes(); v++) {
+        fine_part_of[v] = part_of[coarse_of[level][v]];
+      }
+      part_of.swap(fine_part_of);
+      Refine(fine, part_of);
+    }
+    return part_of;
+  }
+
+  // heavy-edge matching: every node is merged with the unmatched neighbour it
+  // has the heaviest edge to; edges between merged nodes are summed
+  Graph Coarsen(const Graph& fine, int max_node_weight, std::vector<int>& coarse_of,
+                std::default_random_engine& rng) const {
+    int n = fine.num_nodes();
+    std::vector<int> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), rng);
+    std::vector<int> match(n, -1);
+    for (int v : order) {
+      if (match[v] != -1) {
+        continue;
+      }
+      int best = v;
+      int best_weight = 0;
+      for (int i = fine.offsets[v]; i < fine.offsets[v+1]; i++) {
+        int u = fine.adj[i];
+        if ((match[u] == -1) && (u != v) && (fine.edge_weights[i] > best_weight) &&
+            (fine.node_weights[v] + fine.node_weights[u] <= max_node_weight)) {
+          best = u;
+          best_weight = fine.edge_weights[i];
+        }
+      }
+      match[v] = best;
+      match[best] = v;
+    }
+
+    // coarse nodes are numbered in order of their smaller member
+    coarse_of.assign(n, -1);
+    int num_coarse = 0;
+    for (int v = 0; v < n; v++) {
+      if (coarse_of[v] == -1) {
+        coarse_of[v] = coarse_of[match[v]] = num_coarse++;
+      }
+    }
+
+    Graph coarse;
+    coarse.node_weights.reserve(num_coarse);
+    coarse.offsets.reserve(num_coarse + 1);
+    coarse.offsets.push_back(0);
+    std::vector<int> slot(num_coarse, -1); // position of coarse neighbour in adj
+    for (int v = 0; v < n; v++) {
+      if (match[v] < v) {
+        continue;
+      }
+      int c = coarse_of[v];
+      int begin = coarse.adj.size();
+      int members[2] = {v, match[v]};
+      int num_members = (match[v] == v) ? 1 : 2;
+      int weight = 0;
+      for (int m = 0; m < num_members; m++) {
+        weight += fine.node_weights[members[m]];
+        for (int i = fine.offsets[members[m]]; i < fine.offsets[members[m]+1]; i++) {
+          int cu = coarse_of[fine.adj[i]];
+          if (cu == c) {
+            continue;
+          }
+          if (slot[cu] < begin) {
+            slot[cu] = coarse.adj.size();
+            coarse.adj.push_back(cu);
+            coarse.edge_weights.push_back(fine.edge_weights[i]);
+          } else {
+            coarse.edge_weights[slot[cu]] += fine.edge_weights[i];
+          }
+        }
+      }
+      coarse.node_weights.push_back(weight);
+      coarse.offsets.push_back(coarse.adj.size());
+    }
+    return coarse;
+  }
+
+  // parts are grown one after another by BFS from random unassigned seeds
+  // until they reach the average weight; the last part takes the rest
+  std::vector<int> GrowRegions(const Graph& graph, std::default_random_engine& rng) const {
+    int n = graph.num_nodes();
+    int64_t total_weight = std::accumulate(graph.node_weights.begin(), graph.node_weights.end(), int64_t(0));
+    int64_t target = (total_weight + kNumParts - 1) / kNumParts;
+    std::vector<int> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), rng);
+    int next_seed = 0;
+
+    std::vector<int> part_of(n, -1);
+    std::vector<int> queue;
+    for (int part = 0; part < kNumParts - 1; part++) {
+      int64_t weight = 0;
+      queue.clear();
+      size_t head = 0;
+      while (weight < target) {
+        if (head == queue.size()) {
+          // region is enclosed, continue from a new seed
+          while ((next_seed < n) && (part_of[order[next_seed]] != -1)) {
+            next_seed++;
+          }
+          if (next_seed == n) {
+            break;
+          }
+          int seed = order[next_seed];
+          part_of[seed] = part;
+          weight += graph.node_weights[seed];
+          queue.push_back(seed);
+          continue;
+        }
+        int v = queue[head++];
+        for (int i = graph.offsets[v]; (i < graph.offsets[v+1]) && (weight < target); i++) {
+          int u = graph.adj[i];
+          if (part_of[u] == -1) {
+            part_of[u] = part;
+            weight += graph.node_weights[u];
+            queue.push_back(u);
+          }
+        }
+      }
+    }
+    for (int& part : part_of) {
+      if (part == -1) {
+        part = kNumParts - 1;
+      }
+    }
+    return part_of;
+  }
+
+  void Refine(const Graph& graph, std::vector<int>& part_of) {
+    int n = graph.num_nodes();
+    int64_t total_weight = std::accumulate(graph.node_weights.begin(), graph.node_weights.end(), int64_t(0));
+    int64_t max_part_weight = kMaxImbalance * total_weight / kNumParts;
+    PartMap parts(graph, part_of);
+    conn_.assign(kNumParts, 0);
+
+    for (int pass = 0; pass < kMaxPasses; pass++) {
+      T buckets(n, kNumBuckets);
+      int top = -1; // highest bucket that may be non-empty
+      for (int v = 0; v < n; v++) {
+        Move move = BestMove(graph, parts, v, max_part_weight);
+        if (move.part != -1) {
+          int bucket = BucketOf(move.gain);
+          buckets.Assign(v, bucket);
+          top = std::max(top, bucket);
+        }
+      }
+
+      std::vector<char> locked(n, 0);
+      auto savepoint = parts.Save();
+      int64_t cut_delta = 0;
+      int64_t best_cut_delta = 0;
+      int num_fruitless = 0;
+      while (num_fruitless < kMaxFruitlessMoves) {
+        while ((top >= 0) && (buckets.ViewOf(top).begin() == buckets.ViewOf(top).end())) {
+          top--;
+        }
+        if (top < 0) {
+          break;
+        }
+        int v = *buckets.ViewOf(top).begin();
+        Move move = BestMove(graph, parts, v, max_part_weight);
+        int bucket = (move.part != -1) ? BucketOf(move.gain) : -1;
+        if (bucket < top) {
+          buckets.Assign(v, bucket); // gain was stale, v goes down to where it belongs
+          continue;
+        }
+        buckets.Assign(v, -1);
+        locked[v] = 1;
+        parts.Assign(v, move.part);
+        cut_delta -= move.gain;
+        if (cut_delta < best_cut_delta) {
+          best_cut_delta = cut_delta;
+          num_fruitless = 0;
+          parts.Release(savepoint);
+          savepoint = parts.Save();
+        } else {
+          num_fruitless++;
+        }
+
+        for (int i = graph.offsets[v]; i < graph.offsets[v+1]; i++) {
+          int u = graph.adj[i];
+          if (locked[u] || (graph.offsets[u+1] - graph.offsets[u] > kMaxUpdateDegree)) {
+            continue;
+          }
+          Move neighbour_move = BestMove(graph, parts, u, max_part_weight);
+          int bucket = (neighbour_move.part != -1) ? BucketOf(neighbour_move.gain) : -1;
+          buckets.Assign(u, bucket);
+          top = std::max(top, bucket);
+        }
+      }
+      parts.Rollback(savepoint);
+      if (best_cut_delta == 0) {
+        break;
+      }
+    }
+
+    for (int v = 0; v < n; v++) {
+      part_of[v] = parts.PartOf(v);
+    }
+  }
+
+  // most profitable move of v to a part it has edges to, within the weight limit
+  Move BestMove(const Graph& graph, const PartMap& parts, int v, int64_t max_part_weight) {
+    int from = parts.PartOf(v);
+    touched_.clear();
+    for (int i = graph.offsets[v]; i < graph.offsets[v+1]; i++) {
+      int part = parts.PartOf(graph.adj[i]);
+      if (conn_[part] == 0) {
+        touched_.push_back(part);
+      }
+      conn_[part] += graph.edge_weights[i];
+    }
+    Move best{-1, 0};
+    for (int part : touched_) {
+      if ((part != from) && (parts.WeightOf(part) + graph.node_weights[v] <= max_part_weight)) {
+        int64_t gain = conn_[part] - conn_[from];
+        if ((best.part == -1) || (gain > best.gain)) {
+          best = Move{part, gain};
+        }
+      }
+    }
+    for (int part : touched_) {
+      conn_[part] = 0;
+    }
+    return best;
+  }
+
+  static int BucketOf(int64_t gain) {
+    return std::min<int64_t>(std::max<int64_t>(gain, -kMaxGain), kMaxGain) + kMaxGain;
+  }
+
+  static int64_t CutOf(const Graph& graph, const std::vector<int>& part_of) {
+    int64_t cut = 0;
+    for (int v = 0; v < graph.num_nodes(); v++) {
+      for (int i = graph.offsets[v]; i < graph.offsets[v+1]; i++) {
+        if (part_of[graph.adj[i]] != part_of[v]) {
+          cut += graph.edge_weights[i];
+        }
+      }
+    }
+    return cut / 2;
+  }
+
+  static double ImbalanceOf(const Graph& graph, const std::vector<int>& part_of) {
+    std::vector<int64_t> weights(kNumParts, 0);
+    for (int v = 0; v < graph.num_nodes(); v++) {
+      weights[part_of[v]] += graph.node_weights[v];
+    }
+    int64_t total_weight = std::accumulate(weights.begin(), weights.end(), int64_t(0));
+    return *std::max_element(weights.begin(), weights.end()) * double(kNumParts) / total_weight;
+  }
+
+  std::vector<int64_t> conn_; // edge weight from the node to every part, zero between calls
+  std::vector<int> touched_;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+struct IsOrdered : std::false_type {};
+
+template<typename T>
+struct IsOrdered<Ordered<T>> : std::true_type {};
+
+/*
+ * Scheduler queries on weighted items: the lightest and the heaviest item of
+ * a subset and its kTopK heaviest items. Plain containers answer them with a
+ * walk of ViewOf(), Ordered<T> from its per-subset index. Moves are timed
+ * too, since Ordered<T>::Assign() also updates the index.
+ */
+template<typename T>
+class TopItems {
+public:
+  void Run() {
+    std::default_random_engine rng(5521);
+    std::uniform_int_distribution<int> item_dice(0, kNumItems-1);
+    std::uniform_int_distribution<int> subset_dice(0, kNumSubsets-1);
+    std::uniform_int_distribution<int> weight_dice(0, kMaxWeight);
+    std::vector<int> subset_of(kNumItems);
+    for (int& subset : subset_of) {
+      subset = subset_dice(rng);
+    }
+    weights_.resize(kNumItems);
+    for (int& weight : weights_) {
+      weight = weight_dice(rng);
+    }
+
+    auto ts1 = std::chrono::high_resolution_clock::now();
+    T partition = Load(subset_of);
+    auto ts2 = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = ts2 - ts1;
+    std::printf("FromAssignment(): %.3f sec\n", elapsed.count());
+
+    ts1 = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < kNumMoves; i++) {
+      partition.Assign(item_dice(rng), subset_dice(rng));
+    }
+    ts2 = std::chrono::high_resolution_clock::now();
+    elapsed = ts2 - ts1;
+    std::printf("Assign(): %.3f sec | %.0f items/sec\n",
+                elapsed.count(), std::floor(kNumMoves/elapsed.count()));
+
+    std::vector<int> subsets(kNumQueries);
+    for (int& subset : subsets) {
+      subset = subset_dice(rng);
+    }
+    Query(partition, subsets, "Lowest", [this](const T& p, int subset) {
+      return Lowest(p, subset);
+    });
+    Query(partition, subsets, "Highest", [this](const T& p, int subset) {
+      return Highest(p, subset);
+    });
+    std::vector<int> top;
+    Query(partition, subsets, "TopK", [this, &top](const T& p, int subset) {
+      TopK(p, subset, top);
+      uint32_t checksum = 0;
+      for (int item : top) {
+        checksum = checksum * 13 + item;
+      }
+      return checksum;
+    });
+  }
+
+private:
+  static constexpr int kNumItems = 10000000;
+  static constexpr int kNumSubsets = 1000;
+  static constexpr int kMaxWeight = 1000000;
+  static constexpr int kNumMoves = 2000000;
+  static constexpr int kNumQueries = 10000;
+  static constexpr int kTopK = 10;
+
+  T Load(const std::vector<int>& subset_of) const {
+    if constexpr (IsOrdered<T>::value) {
+      return T::FromAssignment(subset_of.data(), kNumItems, kNumSubsets, weights_);
+    } else {
+      return T::FromAssignment(subset_of.data(), kNumItems, kNumSubsets);
+    }
+  }
+
+  template<typename Q>
+  void __attribute__((noinline)) Query(const T& partition, const std::vector<int>& subsets,
+                                       const char* name, Q query) {
+    uint32_t checksum = 0;
+    auto ts1 = std::chrono::high_resolution_clock::now();
+    for (int subset : subsets) {
+      checksum = checksum * 13 + query(partition, subset);
+    }
+    auto ts2 = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = ts2 - ts1;
+    std::printf("%s(): %.3f sec | %.0f queries/sec | checksum=%u\n",
+                name, elapsed.count(), std::floor(subsets.size()/elapsed.count()), checksum);
+  }
+
+  uint64_t KeyOf(int item) const {
+    return (uint64_t(weights_[item]) << 32) | uint32_t(item);
+  }
+
+  int Lowest(const T& partition, int subset) const {
+    if constexpr (IsOrdered<T>::value) {
+      return partition.Lowest(subset);
+    } else {
+      int lowest = -1;
+      for (int item : partition.ViewOf(subset)) {
+        if ((lowest == -1) || (KeyOf(item) < KeyOf(lowest))) {
+          lowest = item;
+        }
+      }
+      return lowest;
+    }
+  }
+
+  int Highest(const T& partition, int subset) const {
+    if constexpr (IsOrdered<T>::value) {
+      return partition.Highest(subset);
+    } else {
+      int highest = -1;
+      for (int item : partition.ViewOf(subset)) {
+        if ((highest == -1) || (KeyOf(item) > KeyOf(highest))) {
+          highest = item;
+        }
+      }
+      return highest;
+    }
+  }
+
+  void TopK(const T& partition, int subset, std::vector<int>& out) const {
+    if constexpr (IsOrdered<T>::value) {
+      partition.TopK(subset, kTopK, out);
+    } else {
+      // min-heap of the kTopK highest keys seen so far
+      std::vector<uint64_t> heap;
+      for (int item : partition.ViewOf(subset)) {
+        uint64_t key = KeyOf(item);
+        if (int(heap.size()) < kTopK) {
+          heap.push_back(key);
+          std::push_heap(heap.begin(), heap.end(), std::greater<uint64_t>());
+        } else if (key > heap.front()) {
+          std::pop_heap(heap.begin(), heap.end(), std::greater<uint64_t>());
+          heap.back() = key;
+          std::push_heap(heap.begin(), heap.end(), std::greater<uint64_t>());
+        }
+      }
+      std::sort(heap.begin(), heap.end(), std::greater<uint64_t>());
+      out.clear();
+      for (uint64_t key : heap) {
+        out.push_back(int(uint32_t(key)));
+      }
+    }
+  }
+
+  std::vector<int> weights_;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+class Unit {
+public:
+  Unit(const std::string& bench_name,
+       const std::string& impl_name,
+       std::function<void()> runner) :
+    bench_name_(bench_name),
+    impl_name_(impl_name),
+    runner_(runner)
+  {
+  }
+
+  const std::string& bench_name() const { return bench_name_; }
+  const std::string& impl_name() const { return impl_name_; }
+  std::function<void()> runner() const { return runner_; }
+
+private:
+  std::string bench_name_;
+  std::string impl_name_;
+  std::function<void()> runner_;
+};
+
+// units which compare Partition policies, registered for every configuration
+template<typename T>
+void RegisterPolicyUnits(const std::string& impl_name, std::vector<Unit>& units) {
+  units.emplace_back(
+    "ops",
+    impl_name,
+    [](){Ops<T>().Run();}
+  );
+  units.emplace_back(
+    "layout",
+    impl_name,
+    [](){LayoutSolver<T>().Run();}
+  );
+  units.emplace_back(
+    "kmeans",
+    impl_name,
+    [](){KMeans<T>().Run();}
+  );
+  units.emplace_back(
+    "balancer",
+    impl_name,
+    [](){Balancer<T>().Run();}
+  );
+}
+
+// kmeans_dims: dimensionality of points in kmeans-md
+template<typename T>
+void Register(const std::string& impl_name, std::vector<Unit>& units, int kmeans_dims) {
+  RegisterPolicyUnits<T>(impl_name, units);
+  units.emplace_back(
+    "lookup",
+    impl_name,
+    [](){Lookups<T>().Run();}
+  );
+  units.emplace_back(
+    "kmeans-mt",
+    impl_name,
+    [](){KMeans<T>(std::max<int>(std::thread::hardware_concurrency(), 1)).Run();}
+  );
+  units.emplace_back(
+    "kmeans-md",
+    impl_name,
+    [kmeans_dims](){KMeansMD<T>(kmeans_dims).Run();}
+  );
+  units.emplace_back(
+    "racks",
+    impl_name,
+    [](){RackBalancer<T>().Run();}
+  );
+  units.emplace_back(
+    "graph",
+    impl_name,
+    [](){GraphPartitioner<T>().Run();}
+  );
+}
+
+template<typename... Ts>
+struct TypeList {};
+
+// register Partition<Storage, Layout, SubsetIndex> for every SubsetIndex
+template<typename Storage, typename Layout, typename... SubsetIndexes>
+void RegisterSubsetIndexes(std::vector<Unit>& units, TypeList<SubsetIndexes...>) {
+  (RegisterPolicyUnits<Partition<Storage, Layout, SubsetIndexes>>(
+       Partition<Storage, Layout, SubsetIndexes>::Name(), units), ...);
+}
+
+template<typename Storage, typename SubsetIndexList, typename... Layouts>
+void RegisterLayouts(std::vector<Unit>& units, TypeList<Layouts...>) {
+  (RegisterSubsetIndexes<Storage, Layouts>(units, SubsetIndexList()), ...);
+}
+
+// register the cartesian product Storages x Layouts x SubsetIndexes
+template<typename LayoutList, typename SubsetIndexList, typename... Storages>
+void RegisterPolicies(std::vector<Unit>& units, TypeList<Storages...>) {
+  (RegisterLayouts<Storages, SubsetIndexList>(units, LayoutList()), ...);
+}
+
+int main(int argc, char* argv[]) {
+  ::setlinebuf(stdout);
+
+  /*
+   * Options go before positional arguments:
+   *   --list     print "<bench> <impl>" of the selected units instead of running them;
+   *   --dims=<d> dimensionality of points in kmeans-md, 128 floats is a 512-byte row.
+   */
+  bool list = false;
+  int kmeans_dims = 128;
+  int arg = 1;
+  bool bad_usage = false;
+  for (; (arg < argc) && (std::string(argv[arg]).compare(0, 2, "--") == 0); arg++) {
+    std::string option(argv[arg]);
+    if (option == "--list") {
+      list = true;
+    } else if (option.compare(0, 7, "--dims=") == 0) {
+      kmeans_dims = std::atoi(option.c_str() + 7);
+      bad_usage = bad_usage || (kmeans_dims <= 0);
+    } else {
+      bad_usage = true;
+    }
+  }
+  if (bad_usage || (argc - arg > 2)) {
+    std::printf("Usage: %s [--list] [--dims=<d>] [<bench> [<impl>]]\n", argv[0]);
+    return 1;
+  }
+  std::string bench_name;
+  std::string impl_name;
+  if (arg < argc) {
+    bench_name = std::string(argv[arg]);
+    if (arg + 1 < argc) {
+      impl_name = std::string(argv[arg + 1]);
+    }
+  }
+
+  std::vector<Unit> units;
+  Register<PolyRbSet>("PolyRbSet", units, kmeans_dims);
+  Register<PolyHashSet>("PolyHashSet", units, kmeans_dims);
+  Register<PolyHopscotchSet>("PolyHopscotchSet", units, kmeans_dims);
+  Register<ItemTwine>("ItemTwine", units, kmeans_dims);
+  Register<ChunkTwine<123>>("ChunkTwine", units, kmeans_dims);
+  Register<Carousel>("Carousel", units, kmeans_dims);
+  Register<EpochTwine<123>>("EpochTwine", units, kmeans_dims);
+  RegisterPolicies<TypeList<AoS, SoA>, TypeList<int16_t, int32_t>>(
+      units,
+      TypeList<VectorStorage<SwapRemove>, VectorStorage<LazyRemove>, ChunkStorage<123>, ListStorage>());
+  units.emplace_back(
+    "readers",
+    "EpochTwine",
+    [](){ReadWhileWrite<EpochTwine<123>>().Run();}
+  );
+  units.emplace_back(
+    "replicas",
+    "ReplicaTwine",
+    [](){ReplicaBalancer<ReplicaTwine<123, 3>>().Run();}
+  );
+  units.emplace_back(
+    "shm",
+    "ShmTwine",
+    [](){SharedReaders<ShmTwine<123>>().Run();}
+  );
+  units.emplace_back(
+    "churn",
+    "ChunkTwine",
+    [](){Churn<ChunkTwine<123>>().Run();}
+  );
+  units.emplace_back(
+    "ordered",
+    "ChunkTwine",
+    [](){TopItems<ChunkTwine<123>>().Run();}
+  );
+  units.emplace_back(
+    "ordered",
+    "Ordered/ChunkTwine",
+    [](){TopItems<Ordered<ChunkTwine<123>>>().Run();}
+  );
+
+  if (!bench_name.empty()) {
+    units.erase(
       std::remove_if(
         units.begin(),
         units.end(),
@@ -499,6 +2244,13 @@ int main(int argc, char* argv[]) {
     );
   }
 
+  if (list) {
+    for (const Unit& unit : units) {
+      std::printf("%s %s\n", unit.bench_name().c_str(), unit.impl_name().c_str());
+    }
+    return 0;
+  }
+
   for (const Unit& unit : units) {
     std::printf("[%s] %s\n", unit.impl_name().c_str(), unit.bench_name().c_str());
     unit.runner()();
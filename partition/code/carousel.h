@@ -1,6 +1,11 @@
 #pragma once
 
 #include <memory>
+#include <algorithm>
+#include <vector>
+
+#include "slice.h"
+#include "undo_log.h"
 
 class Carousel {
 private:
@@ -94,10 +99,35 @@ public:
     return SubsetView(ring_, subset_data_[subset]);
   }
 
+  // split subset into up to max_slices slices of (almost) equal length
+  typedef Slice<SubsetView::Iterator> SubsetSlice;
+  std::vector<SubsetSlice> SplitViewOf(int subset, int max_slices) const {
+    typedef SubsetView::Iterator Iterator;
+    const SubsetData& sd = subset_data_[subset];
+    auto Wrap = [&](int pos) {
+      return (pos >= ring_.size()) ? pos - ring_.size() : pos;
+    };
+
+    std::vector<SubsetSlice> slices;
+    int num_slices = std::max(std::min(max_slices, sd.size), 1);
+    int pos = sd.begin;
+    for (int i = 0; i < num_slices; i++) {
+      int first = pos;
+      pos = Wrap(pos + sd.size / num_slices + (i < sd.size % num_slices ? 1 : 0));
+      slices.emplace_back(Iterator(ring_, first), Iterator(ring_, pos));
+    }
+    return slices;
+  }
+
   int SubsetOf(int item) const {
     return item_data_[item].subset;
   }
 
+  // for SubsetOfMany()
+  void PrefetchItem(int item) const {
+    __builtin_prefetch(&item_data_[item], 0/*read*/, 1);
+  }
+
   Carousel(int num_items, int num_subsets) :
       item_data_(num_items),
       subset_data_(num_subsets),
@@ -119,20 +149,96 @@ public:
     }
   }
 
+  /*
+   * Bulk load from subset_of[item] array. Items are counting-sorted into ring_
+   * subset after subset, and free slots are spread evenly between subsets so
+   * that later Include() calls do not have to relocate long cascades.
+   */
+  static Carousel FromAssignment(const int* subset_of, int num_items, int num_subsets) {
+    Carousel carousel(num_items, num_subsets);
+
+    // count items per subset
+    for (int item = 0; item < num_items; item++) {
+      if (subset_of[item] != -1) {
+        carousel.subset_data_[subset_of[item]].size++;
+      }
+    }
+
+    // place subsets: prefix sum of sizes plus even share of free slots
+    int64_t total = 0;
+    for (int s = 0; s < num_subsets; s++) {
+      total += carousel.subset_data_[s].size;
+    }
+    int64_t slack = carousel.ring_.size() - total;
+    int64_t prefix = 0;
+    std::vector<int> cursor(num_subsets);
+    for (int s = 0; s < num_subsets; s++) {
+      int begin = prefix + slack * s / num_subsets;
+      carousel.subset_data_[s].begin = begin;
+      cursor[s] = begin;
+      prefix += carousel.subset_data_[s].size;
+    }
+
+    // scatter items
+    for (int item = 0; item < num_items; item++) {
+      int s = subset_of[item];
+      if (s == -1) {
+        continue;
+      }
+      int pos = cursor[s]++;
+      carousel.ring_[pos] = item;
+      carousel.item_data_[item].subset = s;
+      carousel.item_data_[item].pos = pos;
+    }
+
+    return carousel;
+  }
+
   void Assign(int item, int subset) {
     ItemData& id = item_data_[item];
     if (id.subset == subset) {
       return;
     }
+    Move move{item, id.subset, id.pos, (subset != -1) ? subset_data_[subset].begin : -1, 0};
     if (id.subset != -1) {
       Exclude(item, id.subset, id.pos);
     }
     if (subset != -1) {
-      Include(item, subset);
+      move.num_relocated = Include(item, subset);
     }
+    if (moves_.logging()) {
+      moves_.Push(move);
+    }
+  }
+
+  /*
+   * Trial moves: Rollback() undoes all Assign() calls made since Savepoint(),
+   * including relocation cascades, and puts every item back to its old slot.
+   * A move is logged as the old slot of the item and the length of its
+   * cascade, and is undone by walking the cascade backwards.
+   */
+  int Savepoint() {
+    return moves_.Savepoint();
+  }
+
+  void Rollback(int savepoint) {
+    moves_.Rollback(savepoint, [this](const Move& move) { Undo(move); });
+  }
+
+  void Release(int savepoint) {
+    moves_.Release(savepoint);
   }
 
 private:
+  // item, its old slot and what Include() did to the new subset
+  struct Move {
+    int item;
+    int subset;
+    int pos;
+    int begin; // of the new subset before the move
+    int num_relocated;
+  };
+
   void Exclude(int item, int subset, int pos) {
     int rpos = subset_data_[subset].begin + subset_data_[subset].size - 1;
     if (rpos >= ring_.size()) {
@@ -150,7 +256,8 @@ private:
     item_data_[item].pos = -1;
   }
 
-  void Include(int item, int subset) {
+  // returns number of items relocated to make room for item
+  int Include(int item, int subset) {
     item_data_[item].subset = subset;
 
     if (subset_data_[subset].size == 0) {
@@ -165,6 +272,7 @@ private:
       subset_data_[subset].begin = begin;
     }
 
+    int num_relocated = 0;
     while (true) {
       // find position for an item, and its current occupant
       int pos = subset_data_[subset].begin + subset_data_[subset].size;
@@ -190,7 +298,57 @@ private:
       subset_data_[old_subset].size--;
       item = old_item;
       subset = old_subset;
+      num_relocated++;
+    }
+    return num_relocated;
+  }
+
+  /*
+   * Inverse of the latest logged Assign(). Item is the last one of its
+   * current subset; every relocated item is the last one of the subset which
+   * follows the slot it was relocated from, and goes back to that slot.
+   */
+  void Undo(const Move& move) {
+    int item = move.item;
+    int subset = item_data_[item].subset;
+    if (subset != -1) {
+      int pos = item_data_[item].pos;
+      subset_data_[subset].size--;
+      for (int i = 0; i < move.num_relocated; i++) {
+        int next = pos + 1;
+        if (next >= ring_.size()) {
+          next -= ring_.size();
+        }
+        SubsetData& sd = subset_data_[item_data_[ring_[next]].subset];
+        int last = sd.begin + sd.size - 1;
+        if (last >= ring_.size()) {
+          last -= ring_.size();
+        }
+        ring_[pos] = ring_[last];
+        item_data_[ring_[pos]].pos = pos;
+        sd.begin = pos;
+        pos = last;
+      }
+      ring_[pos] = -1;
+      subset_data_[subset].begin = move.begin;
+    }
+
+    if (move.subset != -1) {
+      // the item that took the old slot returns to the back of the subset
+      SubsetData& sd = subset_data_[move.subset];
+      int rpos = sd.begin + sd.size;
+      if (rpos >= ring_.size()) {
+        rpos -= ring_.size();
+      }
+      sd.size++;
+      if (rpos != move.pos) {
+        ring_[rpos] = ring_[move.pos];
+        item_data_[ring_[rpos]].pos = rpos;
+      }
+      ring_[move.pos] = item;
     }
+    item_data_[item].subset = move.subset;
+    item_data_[item].pos = move.pos;
   }
 
   static int ComputeRingCapacity(int num_items, int num_subsets) {
@@ -205,5 +363,6 @@ private:
   Buffer<ItemData> item_data_;
   Buffer<SubsetData> subset_data_;
   Buffer<int> ring_;
+  MoveLog<Move> moves_;
 };
 
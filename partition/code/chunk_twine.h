@@ -1,11 +1,28 @@
 #pragma once
 
+#include <cassert>
 #include <memory>
 #include <array>
+#include <algorithm>
+#include <vector>
+
+#include "slice.h"
+#include "undo_log.h"
+
+template<int kChunkCapacity, int kMaxReplicas>
+class ReplicaTwine;
+
+template<int kChunkCapacity>
+class ShmTwine;
 
 template<int kChunkCapacity>
 class ChunkTwine {
 private:
+  // ReplicaTwine shares Chunk, SubsetView and the chunk list operations;
+  // ShmTwine copies the chunk pool into its shared region
+  template<int, int> friend class ReplicaTwine;
+  template<int> friend class ShmTwine;
+
   struct Chunk {
     Chunk() :
         next(nullptr),
@@ -103,66 +120,273 @@ public:
     return SubsetView(subset_data_[subset].back);
   }
 
+  /*
+   * Split subset into up to max_slices slices at chunk boundaries. Only the
+   * chunk list is walked, which is kChunkCapacity times shorter than the
+   * subset itself.
+   */
+  typedef Slice<typename SubsetView::Iterator> SubsetSlice;
+  std::vector<SubsetSlice> SplitViewOf(int subset, int max_slices) const {
+    typedef typename SubsetView::Iterator Iterator;
+    Chunk* back = subset_data_[subset].back;
+    int num_chunks = 0;
+    for (Chunk* chunk = back; chunk; chunk = chunk->next) {
+      num_chunks++;
+    }
+
+    std::vector<SubsetSlice> slices;
+    int num_slices = std::max(std::min(max_slices, num_chunks), 1);
+    Chunk* chunk = back;
+    for (int i = 0; i < num_slices; i++) {
+      Chunk* first = chunk;
+      int len = num_chunks / num_slices + (i < num_chunks % num_slices ? 1 : 0);
+      for (int j = 0; j < len; j++) {
+        chunk = chunk->next;
+      }
+      slices.emplace_back(Iterator(first, 0), Iterator(chunk, 0));
+    }
+    return slices;
+  }
+
   ChunkTwine(int num_items, int num_subsets) :
     item_data_(new ItemData[num_items]),
     subset_data_(new SubsetData[num_subsets]),
-    free_(nullptr)
+    free_(nullptr),
+    num_subsets_(num_subsets),
+    num_chunks_(num_subsets + (num_items-num_subsets)/kChunkCapacity)
   {
     // create chunks and add them to the pool of free chunks
-    int num_chunks = num_subsets + (num_items-num_subsets)/kChunkCapacity;
-    chunk_pool_.reset(new Chunk[num_chunks]);
-    for (int i = 0; i < num_chunks; i++) {
+    chunk_pool_.reset(new Chunk[num_chunks_]);
+    for (int i = 0; i < num_chunks_; i++) {
       PushChunk(&free_, &chunk_pool_[i]);
     }
   }
 
+  /*
+   * Bulk load from subset_of[item] array. Items are counting-sorted by subset,
+   * and every subset receives a contiguous run of chunks from the pool, with
+   * the partially filled chunk at the back, exactly as Assign() would keep it.
+   */
+  static ChunkTwine FromAssignment(const int* subset_of, int num_items, int num_subsets) {
+    ChunkTwine twine(num_items, num_subsets);
+
+    // count items per subset and reserve a run of chunks for each subset
+    std::vector<int> sizes(num_subsets, 0);
+    for (int item = 0; item < num_items; item++) {
+      if (subset_of[item] != -1) {
+        sizes[subset_of[item]]++;
+      }
+    }
+    int num_chunks = twine.num_chunks_;
+    int num_used = 0;
+    std::vector<Chunk*> cursor(num_subsets, nullptr);
+    for (int s = 0; s < num_subsets; s++) {
+      int size = sizes[s];
+      int len = (size + kChunkCapacity - 1) / kChunkCapacity;
+      Chunk* run = &twine.chunk_pool_[num_used];
+      for (int i = 0; i < len; i++) {
+        run[i].prev = (i > 0) ? &run[i-1] : nullptr;
+        run[i].next = (i+1 < len) ? &run[i+1] : nullptr;
+        run[i].num_items = kChunkCapacity;
+      }
+      if (len > 0) {
+        run[0].num_items = size - (len-1)*kChunkCapacity;
+        twine.subset_data_[s].back = run;
+        cursor[s] = run;
+      }
+      num_used += len;
+    }
+
+    // the rest of the pool is free, pushed backwards so that pops go forward
+    twine.free_ = nullptr;
+    for (int i = num_chunks - 1; i >= num_used; i--) {
+      twine.chunk_pool_[i].num_items = 0;
+      twine.PushChunk(&twine.free_, &twine.chunk_pool_[i]);
+    }
+
+    // scatter items into their runs
+    std::vector<int> chpos(num_subsets, 0);
+    for (int item = 0; item < num_items; item++) {
+      int s = subset_of[item];
+      if (s == -1) {
+        continue;
+      }
+      if (chpos[s] == cursor[s]->num_items) {
+        cursor[s]++; // next chunk of the run is adjacent in the pool
+        chpos[s] = 0;
+      }
+      ItemData& id = twine.item_data_[item];
+      id.subset = s;
+      id.chunk = cursor[s];
+      id.chpos = chpos[s]++;
+      id.chunk->items[id.chpos] = item;
+    }
+
+    return twine;
+  }
+
   int SubsetOf(int item) const {
     return item_data_[item].subset;
   }
 
+  // bring metadata of item into cache ahead of SubsetOf(), see SubsetOfMany()
+  void PrefetchItem(int item) const {
+    __builtin_prefetch(&item_data_[item], 0/*read*/, 1);
+  }
+
   void Assign(int item, int subset) {
     if (item_data_[item].subset == subset) {
       return;
     }
-
+    if (moves_.logging()) {
+      const ItemData& id = item_data_[item];
+      moves_.Push(Move{id.chunk, id.chpos, item, id.subset});
+    }
     if (item_data_[item].subset != -1) {
-      ItemData& id = item_data_[item];
-      Chunk* back_chunk = subset_data_[id.subset].back;
-      int back_item = back_chunk->items[--back_chunk->num_items];
-      if (back_chunk->num_items == 0) {
-        PopChunk(&subset_data_[id.subset].back);
-        PushChunk(&free_, back_chunk);
-      }
+      Remove(item);
+    }
+    if (subset != -1) {
+      Insert(item, subset);
+    }
+  }
+
+  /*
+   * Trial moves: Assign() calls made after Savepoint() are undone by
+   * Rollback(), which restores chunk contents, chunk lists and item metadata
+   * exactly as they were. Only the old slot of every moved item is logged;
+   * moves are undone newest first by their inverse, in O(number of moves).
+   */
+  int Savepoint() {
+    return moves_.Savepoint();
+  }
+
+  void Rollback(int savepoint) {
+    moves_.Rollback(savepoint, [this](const Move& move) { Undo(move); });
+  }
+
+  void Release(int savepoint) {
+    moves_.Release(savepoint);
+  }
 
-      if (item != back_item) {
-        // move back item to the position previously occupied by item
-        id.chunk->items[id.chpos] = back_item;
-        item_data_[back_item].chunk = id.chunk;
-        item_data_[back_item].chpos = id.chpos;
+  /*
+   * Relocate chunks of every subset into a contiguous run of the pool, runs
+   * ordered by subset and every run in list order, as FromAssignment() lays
+   * them out. After heavy churn chunk lists are scattered over the pool;
+   * compaction makes iteration a forward sweep through memory again. Items
+   * keep their chunk positions. Takes O(number of items) time and a second
+   * pool for the duration of the call; must not be called with an open
+   * savepoint.
+   */
+  void Compact() {
+    assert(!moves_.logging());
+    std::unique_ptr<Chunk[]> pool(new Chunk[num_chunks_]);
+    int num_used = 0;
+    for (int s = 0; s < num_subsets_; s++) {
+      Chunk* run = &pool[num_used];
+      int len = 0;
+      for (Chunk* chunk = subset_data_[s].back; chunk; chunk = chunk->next) {
+        Chunk& moved = run[len];
+        moved.items = chunk->items;
+        moved.num_items = chunk->num_items;
+        moved.prev = (len > 0) ? &run[len-1] : nullptr;
+        if (len > 0) {
+          run[len-1].next = &moved;
+        }
+        for (int i = 0; i < moved.num_items; i++) {
+          item_data_[moved.items[i]].chunk = &moved;
+        }
+        len++;
       }
+      subset_data_[s].back = (len > 0) ? run : nullptr;
+      num_used += len;
+    }
 
-      item_data_[item].subset = -1;
-      item_data_[item].chunk = nullptr;
-      item_data_[item].chpos = -1;
+    free_ = nullptr;
+    for (int i = num_chunks_ - 1; i >= num_used; i--) {
+      PushChunk(&free_, &pool[i]);
     }
+    chunk_pool_ = std::move(pool);
+  }
 
-    if (subset != -1) {
-      Chunk* chunk = subset_data_[subset].back;
+private:
+  // item and the slot it occupied before a logged Assign()
+  struct Move {
+    Chunk* chunk;
+    int chpos;
+    int item;
+    int subset;
+  };
+
+  // remove item from the subset it is currently assigned to
+  void Remove(int item) {
+    ItemData& id = item_data_[item];
+    Chunk* back_chunk = subset_data_[id.subset].back;
+    back_chunk->num_items--;
+    int back_item = back_chunk->items[back_chunk->num_items];
+    if (back_chunk->num_items == 0) {
+      PopChunk(&subset_data_[id.subset].back);
+      PushChunk(&free_, back_chunk);
+    }
+
+    if (item != back_item) {
+      // move back item to the position previously occupied by item
+      id.chunk->items[id.chpos] = back_item;
+      item_data_[back_item].chunk = id.chunk;
+      item_data_[back_item].chpos = id.chpos;
+    }
+
+    id.subset = -1;
+    id.chunk = nullptr;
+    id.chpos = -1;
+  }
+
+  // add item to the back of given subset
+  void Insert(int item, int subset) {
+    Chunk* chunk = subset_data_[subset].back;
+    if (!chunk || (chunk->num_items == kChunkCapacity)) {
+      chunk = PopChunk(&free_);
+      chunk->num_items = 0;
+      PushChunk(&subset_data_[subset].back, chunk);
+    }
+    int chpos = chunk->num_items++;
+    chunk->items[chpos] = item;
+    item_data_[item].subset = subset;
+    item_data_[item].chunk = chunk;
+    item_data_[item].chpos = chpos;
+  }
+
+  /*
+   * Inverse of the latest logged Assign(): item is the last one of its
+   * current subset, and the chunk freed by the move, if any, is at the top
+   * of the free list.
+   */
+  void Undo(const Move& move) {
+    int item = move.item;
+    if (item_data_[item].subset != -1) {
+      Remove(item);
+    }
+    if (move.subset != -1) {
+      // the item that took the old slot returns to the back of the subset
+      Chunk* chunk = subset_data_[move.subset].back;
       if (!chunk || (chunk->num_items == kChunkCapacity)) {
         chunk = PopChunk(&free_);
-        chunk->num_items = 0;
-        PushChunk(&subset_data_[subset].back, chunk);
+        PushChunk(&subset_data_[move.subset].back, chunk);
       }
       int chpos = chunk->num_items++;
-      chunk->items[chpos] = item;
-      item_data_[item].subset = subset;
-      item_data_[item].chunk = chunk;
-      item_data_[item].chpos = chpos;
+      if ((move.chunk != chunk) || (move.chpos != chpos)) {
+        int back_item = move.chunk->items[move.chpos];
+        chunk->items[chpos] = back_item;
+        item_data_[back_item].chunk = chunk;
+        item_data_[back_item].chpos = chpos;
+      }
+      move.chunk->items[move.chpos] = item;
     }
+    item_data_[item].subset = move.subset;
+    item_data_[item].chunk = move.chunk;
+    item_data_[item].chpos = move.chpos;
   }
 
-private:
-  Chunk* PopChunk(Chunk** back) {
+  static Chunk* PopChunk(Chunk** back) {
     Chunk* chunk = *back;
     *back = chunk->next;
     if (*back) {
@@ -172,7 +396,7 @@ private:
     return chunk;
   }
 
-  void PushChunk(Chunk** back, Chunk* chunk) {
+  static void PushChunk(Chunk** back, Chunk* chunk) {
     chunk->next = *back;
     chunk->prev = nullptr;
     if (*back) {
@@ -185,5 +409,8 @@ private:
   std::unique_ptr<SubsetData[]> subset_data_;
   std::unique_ptr<Chunk[]> chunk_pool_;
   Chunk* free_;
+  int num_subsets_;
+  int num_chunks_;
+  MoveLog<Move> moves_;
 };
 
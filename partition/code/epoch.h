@@ -0,0 +1,109 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+/*
+ * Epoch-based reclamation for one writer and a fixed number of readers.
+ *
+ * Reader #r wraps every access to shared objects into a read section
+ * (ReadGuard), which announces the global epoch observed at entry. Writer
+ * unlinks an object first and then retires it: the object is stamped with
+ * the current global epoch and is destroyed only when every reader that is
+ * still inside a read section has entered in a later epoch, i.e. after all
+ * readers that could have seen the object have left.
+ */
+class EpochDomain {
+private:
+  static constexpr uint64_t kIdle = std::numeric_limits<uint64_t>::max();
+  static constexpr size_t kReclaimThreshold = 1024;
+
+  struct alignas(64) Slot {
+    Slot() : epoch(kIdle) {}
+    std::atomic<uint64_t> epoch;
+  };
+
+  struct Retired {
+    void* ptr;
+    void (*deleter)(void*);
+    uint64_t epoch;
+  };
+
+public:
+  EpochDomain(int max_readers) :
+      epoch_(1),
+      slots_(new Slot[max_readers]),
+      max_readers_(max_readers),
+      reclaim_at_(kReclaimThreshold) {}
+
+  ~EpochDomain() {
+    for (const Retired& r : retired_) {
+      r.deleter(r.ptr);
+    }
+  }
+
+  EpochDomain(const EpochDomain&) = delete;
+  EpochDomain& operator=(const EpochDomain&) = delete;
+
+  // RAII read section of reader #reader, must not be nested
+  class ReadGuard {
+  public:
+    ReadGuard(EpochDomain& domain, int reader) : slot_(domain.slots_[reader]) {
+      // seq_cst store orders announcement before subsequent pointer loads
+      slot_.epoch.store(domain.epoch_.load(std::memory_order_relaxed));
+    }
+    ~ReadGuard() {
+      slot_.epoch.store(kIdle, std::memory_order_release);
+    }
+    ReadGuard(const ReadGuard&) = delete;
+    ReadGuard& operator=(const ReadGuard&) = delete;
+  private:
+    Slot& slot_;
+  };
+
+  // writer: object must already be unreachable for readers entering from now on
+  template<typename T>
+  void Retire(T* ptr) {
+    retired_.push_back(Retired{
+      ptr,
+      [](void* p) { delete static_cast<T*>(p); },
+      epoch_.load(std::memory_order_relaxed)
+    });
+    if (retired_.size() >= reclaim_at_) {
+      Reclaim();
+      // if long read sections keep objects alive, back off instead of rescanning them
+      reclaim_at_ = std::max(kReclaimThreshold, 2 * retired_.size());
+    }
+  }
+
+  // writer: advance epoch and destroy retired objects no reader can hold
+  void Reclaim() {
+    epoch_.fetch_add(1);
+    uint64_t min_epoch = kIdle;
+    for (int r = 0; r < max_readers_; r++) {
+      min_epoch = std::min(min_epoch, slots_[r].epoch.load());
+    }
+    size_t kept = 0;
+    for (const Retired& r : retired_) {
+      if (r.epoch < min_epoch) {
+        r.deleter(r.ptr);
+      } else {
+        retired_[kept++] = r;
+      }
+    }
+    retired_.resize(kept);
+  }
+
+  size_t num_retired() const { return retired_.size(); }
+
+private:
+  std::atomic<uint64_t> epoch_;
+  std::unique_ptr<Slot[]> slots_;
+  int max_readers_;
+  std::vector<Retired> retired_; // writer only
+  size_t reclaim_at_;
+};
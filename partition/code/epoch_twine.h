@@ -0,0 +1,425 @@
+#pragma once
+
+#include <memory>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+
+#include "epoch.h"
+#include "slice.h"
+#include "undo_log.h"
+
+/*
+ * Copy-on-write variant of ChunkTwine for one writer and many readers.
+ *
+ * Every subset is published as an immutable Snapshot: a directory of
+ * immutable chunks, the last one being partially filled. The directory is a
+ * persistent radix tree with kFanout slots per node. Assign() never modifies
+ * published memory; it copies the (at most two) chunks it touches and the
+ * tree nodes on their paths from the root, publishes the new snapshot with a
+ * single atomic store and retires the old objects into EpochDomain. A write
+ * costs O(kFanout * height) no matter how large the subset is; with
+ * kChunkCapacity = 123, a tree of height 2 holds 4M items.
+ *
+ * A reader which called ViewOf() inside a read section iterates a stable
+ * snapshot of the subset until it leaves the section, no matter what the
+ * writer does meanwhile.
+ *
+ * Snapshots of different subsets are published independently, so a reader
+ * may briefly see a moving item in neither of the subsets.
+ */
+template<int kChunkCapacity>
+class EpochTwine {
+private:
+  struct Chunk {
+    Chunk() : num_items(0) {}
+
+    std::array<int, kChunkCapacity> items;
+    int num_items;
+  };
+
+  static constexpr int kFanoutBits = 5;
+  static constexpr int kFanout = 1 << kFanoutBits;
+
+  // node of the chunk directory; nodes created by the write in progress are modified in place
+  struct Node {
+    Node(uint64_t version) : slots{}, version(version) {}
+
+    std::array<void*, kFanout> slots; // Node* above the leaves, Chunk* in the leaves
+    uint64_t version; // write which created the node
+  };
+
+  /*
+   * Chunks [0, num_chunks), only the last one may be partially filled. The
+   * root node is part of the snapshot, so it is copied along with it.
+   * Nodes emptied by popped chunks stay in the tree for chunks appended later.
+   */
+  struct Snapshot {
+    Snapshot() : root(0), height(0), num_chunks(0) {}
+
+    Chunk* ChunkAt(int chidx) const {
+      const Node* node = &root;
+      for (int h = height; h > 0; h--) {
+        node = static_cast<const Node*>(node->slots[(chidx >> (h * kFanoutBits)) & (kFanout - 1)]);
+      }
+      return static_cast<Chunk*>(node->slots[chidx & (kFanout - 1)]);
+    }
+
+    Node root;
+    int height; // root is a leaf at height 0
+    int num_chunks;
+  };
+
+  struct ItemData {
+    ItemData() :
+        subset(-1),
+        chidx(-1),
+        chpos(-1) {}
+
+    std::atomic<int> subset;
+    int chidx; // index of chunk in the Snapshot directory
+    int chpos; // position inside Chunk.items
+  };
+
+  struct SubsetData {
+    SubsetData() : snapshot(new Snapshot()) {}
+
+    std::atomic<Snapshot*> snapshot;
+  };
+
+  struct Move {
+    int item;
+    int subset; // before the move
+  };
+
+public:
+  class SubsetView {
+  public:
+    SubsetView(const Snapshot* snapshot) : snapshot_(snapshot) {}
+
+    class Iterator {
+    public:
+      using iterator_category = std::forward_iterator_tag;
+      using difference_type   = std::ptrdiff_t;
+      using value_type        = int;
+      using pointer           = int*;
+      using reference         = int;
+
+      Iterator(const Snapshot* snapshot, int chidx, int chpos) :
+          snapshot_(snapshot), chidx_(chidx), chunk_(nullptr), chpos_(chpos)
+      {
+        Locate();
+      }
+
+      reference operator*() const {
+        return chunk_->items[chpos_];
+      }
+
+      Iterator& operator++() {
+        chpos_++;
+        if (chpos_ >= chunk_->num_items) {
+          chidx_++;
+          chpos_ = 0;
+          Locate();
+        }
+        return *this;
+      }
+
+      Iterator operator++(int) {
+        Iterator tmp = *this;
+        ++(*this);
+        return tmp;
+      }
+
+      bool operator== (const Iterator& that) const {
+        return (this->chidx_ == that.chidx_) && (this->chpos_ == that.chpos_);
+      }
+
+      bool operator!= (const Iterator& that) const {
+        return (this->chidx_ != that.chidx_) || (this->chpos_ != that.chpos_);
+      }
+
+    private:
+      // look up current chunk and prefetch the next one
+      void Locate() {
+        if (chidx_ < snapshot_->num_chunks) {
+          chunk_ = snapshot_->ChunkAt(chidx_);
+          if (chidx_ + 1 < snapshot_->num_chunks) {
+            __builtin_prefetch(snapshot_->ChunkAt(chidx_ + 1), 0/*read*/, 1);
+          }
+        }
+      }
+
+      const Snapshot* snapshot_;
+      int chidx_;
+      const Chunk* chunk_; // between chidx_ and chpos_, or GCC compares the pair through a stack spill
+      int chpos_;
+    };
+
+    Iterator begin() const { return Iterator(snapshot_, 0, 0); }
+    Iterator end() const { return Iterator(snapshot_, snapshot_->num_chunks, 0); }
+
+  private:
+    const Snapshot* snapshot_;
+  };
+
+  // view stays valid until reader leaves its read section
+  SubsetView ViewOf(int subset) const {
+    return SubsetView(subset_data_[subset].snapshot.load());
+  }
+
+  // split subset into up to max_slices slices at chunk boundaries
+  typedef Slice<typename SubsetView::Iterator> SubsetSlice;
+  std::vector<SubsetSlice> SplitViewOf(int subset, int max_slices) const {
+    typedef typename SubsetView::Iterator Iterator;
+    const Snapshot* snapshot = subset_data_[subset].snapshot.load();
+    int num_chunks = snapshot->num_chunks;
+
+    std::vector<SubsetSlice> slices;
+    int num_slices = std::max(std::min(max_slices, num_chunks), 1);
+    int chidx = 0;
+    for (int i = 0; i < num_slices; i++) {
+      int first = chidx;
+      chidx += num_chunks / num_slices + (i < num_chunks % num_slices ? 1 : 0);
+      slices.emplace_back(Iterator(snapshot, first, 0), Iterator(snapshot, chidx, 0));
+    }
+    return slices;
+  }
+
+  EpochTwine(int num_items, int num_subsets, int max_readers = 1) :
+      item_data_(new ItemData[num_items]),
+      subset_data_(new SubsetData[num_subsets]),
+      num_subsets_(num_subsets),
+      epochs_(max_readers),
+      version_(0) {}
+
+  ~EpochTwine() {
+    for (int s = 0; s < num_subsets_; s++) {
+      Snapshot* snapshot = subset_data_[s].snapshot.load();
+      FreeBelow(snapshot->root, snapshot->height);
+      delete snapshot;
+    }
+  }
+
+  EpochTwine(const EpochTwine&) = delete;
+  EpochTwine& operator=(const EpochTwine&) = delete;
+
+  // bulk load from subset_of[item] array, must be done before readers start
+  static EpochTwine FromAssignment(const int* subset_of, int num_items, int num_subsets, int max_readers = 1) {
+    return EpochTwine(subset_of, num_items, num_subsets, max_readers);
+  }
+
+  int SubsetOf(int item) const {
+    return item_data_[item].subset.load(std::memory_order_relaxed);
+  }
+
+  // for SubsetOfMany()
+  void PrefetchItem(int item) const {
+    __builtin_prefetch(&item_data_[item], 0/*read*/, 1);
+  }
+
+  /*
+   * Trial moves. Restoring published snapshots would hand readers stale
+   * views, so the log holds previous subsets of moved items and Rollback()
+   * re-assigns them backwards; item order inside chunks may differ.
+   */
+  int Savepoint() {
+    return moves_.Savepoint();
+  }
+
+  void Rollback(int savepoint) {
+    moves_.Rollback(savepoint, [this](const Move& move) { Assign(move.item, move.subset); });
+  }
+
+  void Release(int savepoint) {
+    moves_.Release(savepoint);
+  }
+
+  // writer only
+  void Assign(int item, int subset) {
+    int curr_subset = item_data_[item].subset.load(std::memory_order_relaxed);
+    if (curr_subset == subset) {
+      return;
+    }
+    if (moves_.logging()) {
+      moves_.Push(Move{item, curr_subset});
+    }
+    if (curr_subset != -1) {
+      Exclude(item, curr_subset);
+    }
+    if (subset != -1) {
+      Include(item, subset);
+    }
+  }
+
+  // readers use it to open read sections: EpochDomain::ReadGuard(twine.epochs(), reader)
+  EpochDomain& epochs() const { return epochs_; }
+
+private:
+  EpochTwine(const int* subset_of, int num_items, int num_subsets, int max_readers) :
+      EpochTwine(num_items, num_subsets, max_readers)
+  {
+    for (int item = 0; item < num_items; item++) {
+      int subset = subset_of[item];
+      if (subset == -1) {
+        continue;
+      }
+      // nothing is published yet, so all nodes are modified in place
+      Snapshot* snapshot = subset_data_[subset].snapshot.load();
+      Chunk* chunk = (snapshot->num_chunks > 0) ? snapshot->ChunkAt(snapshot->num_chunks - 1) : nullptr;
+      if (!chunk || chunk->num_items == kChunkCapacity) {
+        chunk = new Chunk();
+        Append(snapshot, chunk);
+      }
+      ItemData& id = item_data_[item];
+      id.subset.store(subset, std::memory_order_relaxed);
+      id.chidx = snapshot->num_chunks - 1;
+      id.chpos = chunk->num_items++;
+      chunk->items[id.chpos] = item;
+    }
+    version_++;
+  }
+
+  void Exclude(int item, int subset) {
+    Snapshot* old_snapshot = subset_data_[subset].snapshot.load(std::memory_order_relaxed);
+    Snapshot* snapshot = new Snapshot(*old_snapshot);
+
+    // drop back item from the last chunk
+    int back_chidx = snapshot->num_chunks - 1;
+    Chunk* back_chunk = snapshot->ChunkAt(back_chidx);
+    int back_item = back_chunk->items[back_chunk->num_items - 1];
+    Chunk* fresh = nullptr; // private copy, not yet visible to readers
+    if (back_chunk->num_items == 1) {
+      Store(snapshot, back_chidx, nullptr);
+      snapshot->num_chunks--;
+    } else {
+      fresh = new Chunk(*back_chunk);
+      fresh->num_items--;
+      Store(snapshot, back_chidx, fresh);
+    }
+    unlinked_chunks_.push_back(back_chunk);
+
+    if (item != back_item) {
+      // move back item to the position previously occupied by item
+      ItemData& id = item_data_[item];
+      Chunk* chunk = snapshot->ChunkAt(id.chidx);
+      if (chunk != fresh) {
+        unlinked_chunks_.push_back(chunk);
+        chunk = new Chunk(*chunk);
+        Store(snapshot, id.chidx, chunk);
+      }
+      chunk->items[id.chpos] = back_item;
+      item_data_[back_item].chidx = id.chidx;
+      item_data_[back_item].chpos = id.chpos;
+    }
+
+    Publish(subset, snapshot);
+    item_data_[item].subset.store(-1, std::memory_order_relaxed);
+    item_data_[item].chidx = -1;
+    item_data_[item].chpos = -1;
+  }
+
+  void Include(int item, int subset) {
+    Snapshot* old_snapshot = subset_data_[subset].snapshot.load(std::memory_order_relaxed);
+    Snapshot* snapshot = new Snapshot(*old_snapshot);
+
+    int back_chidx = snapshot->num_chunks - 1;
+    Chunk* chunk = (back_chidx >= 0) ? snapshot->ChunkAt(back_chidx) : nullptr;
+    if (!chunk || chunk->num_items == kChunkCapacity) {
+      chunk = new Chunk();
+      Append(snapshot, chunk);
+    } else {
+      unlinked_chunks_.push_back(chunk);
+      chunk = new Chunk(*chunk);
+      Store(snapshot, back_chidx, chunk);
+    }
+    int chpos = chunk->num_items++;
+    chunk->items[chpos] = item;
+
+    Publish(subset, snapshot);
+    item_data_[item].subset.store(subset, std::memory_order_relaxed);
+    item_data_[item].chidx = snapshot->num_chunks - 1;
+    item_data_[item].chpos = chpos;
+  }
+
+  // node of the snapshot being built: copy of node, new empty node if there is none
+  Node* Own(Node* node) {
+    if (!node) {
+      return new Node(version_);
+    }
+    if (node->version == version_) {
+      return node;
+    }
+    unlinked_nodes_.push_back(node);
+    Node* copy = new Node(*node);
+    copy->version = version_;
+    return copy;
+  }
+
+  // put chunk into slot chidx, copying nodes on the path below the root
+  void Store(Snapshot* snapshot, int chidx, Chunk* chunk) {
+    Node* node = &snapshot->root;
+    for (int h = snapshot->height; h > 0; h--) {
+      void*& child = node->slots[(chidx >> (h * kFanoutBits)) & (kFanout - 1)];
+      node = Own(static_cast<Node*>(child));
+      child = node;
+    }
+    node->slots[chidx & (kFanout - 1)] = chunk;
+  }
+
+  void Append(Snapshot* snapshot, Chunk* chunk) {
+    if (snapshot->num_chunks == (1 << ((snapshot->height + 1) * kFanoutBits))) {
+      // tree is full: slots of the root move into its new first child
+      Node* child = new Node(snapshot->root);
+      child->version = version_;
+      snapshot->root = Node(version_);
+      snapshot->root.slots[0] = child;
+      snapshot->height++;
+    }
+    Store(snapshot, snapshot->num_chunks, chunk);
+    snapshot->num_chunks++;
+  }
+
+  // delete nodes and chunks below node
+  static void FreeBelow(const Node& node, int height) {
+    for (void* slot : node.slots) {
+      if (!slot) {
+        continue;
+      }
+      if (height > 0) {
+        Node* child = static_cast<Node*>(slot);
+        FreeBelow(*child, height - 1);
+        delete child;
+      } else {
+        delete static_cast<Chunk*>(slot);
+      }
+    }
+  }
+
+  // replace snapshot of subset, then retire it along with objects it alone referenced
+  void Publish(int subset, Snapshot* snapshot) {
+    Snapshot* old_snapshot = subset_data_[subset].snapshot.exchange(snapshot);
+    epochs_.Retire(old_snapshot);
+    for (Chunk* chunk : unlinked_chunks_) {
+      epochs_.Retire(chunk);
+    }
+    for (Node* node : unlinked_nodes_) {
+      epochs_.Retire(node);
+    }
+    unlinked_chunks_.clear();
+    unlinked_nodes_.clear();
+    version_++;
+  }
+
+  std::unique_ptr<ItemData[]> item_data_;
+  std::unique_ptr<SubsetData[]> subset_data_;
+  int num_subsets_;
+  mutable EpochDomain epochs_;
+  uint64_t version_; // number of published writes
+  // replaced by the snapshot being built
+  std::vector<Chunk*> unlinked_chunks_;
+  std::vector<Node*> unlinked_nodes_;
+  MoveLog<Move> moves_;
+};
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <iterator>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "item_twine.h"
+
+/*
+ * Two-level partition: items are assigned to subsets, and subsets themselves
+ * are assigned to groups (e.g. shards to servers to racks). Item level is kept
+ * in a container of type T, subset level in a container of type G.
+ *
+ * Every item has a weight. Total weights of subsets and of groups are updated
+ * on every move, so aggregates of either level are available in O(1) without
+ * walking the lower level.
+ *
+ * GroupViewOf() iterates all items of a group by chaining views of its
+ * subsets one after another; nothing is copied, and moving a subset to
+ * another group costs the same regardless of the subset size.
+ */
+template<typename T, typename G = ItemTwine>
+class Hierarchy {
+public:
+  typedef decltype(std::declval<const T&>().ViewOf(0).begin()) ItemIterator;
+  typedef decltype(std::declval<const G&>().ViewOf(0).begin()) SubsetIterator;
+
+  class GroupView {
+  public:
+    class Iterator {
+    public:
+      using iterator_category = std::forward_iterator_tag;
+      using difference_type   = std::ptrdiff_t;
+      using value_type        = int;
+      using pointer           = int*;
+      using reference         = int;
+
+      Iterator(const T& items, SubsetIterator subset, SubsetIterator subset_end) :
+          items_(&items), subset_(subset), subset_end_(subset_end)
+      {
+        EnterSubset();
+      }
+
+      reference operator*() const {
+        return **item_;
+      }
+
+      Iterator& operator++() {
+        ++(*item_);
+        if (*item_ == *item_end_) {
+          ++subset_;
+          EnterSubset();
+        }
+        return *this;
+      }
+
+      Iterator operator++(int) {
+        Iterator tmp = *this;
+        ++(*this);
+        return tmp;
+      }
+
+      bool operator== (const Iterator& that) const {
+        return (this->subset_ == that.subset_) &&
+               ((this->subset_ == this->subset_end_) || (*this->item_ == *that.item_));
+      }
+
+      bool operator!= (const Iterator& that) const {
+        return !(*this == that);
+      }
+
+    private:
+      // position at the first item of the current or the next non-empty subset
+      void EnterSubset() {
+        for (; subset_ != subset_end_; ++subset_) {
+          auto&& view = items_->ViewOf(*subset_);
+          item_.emplace(view.begin());
+          item_end_.emplace(view.end());
+          if (*item_ != *item_end_) {
+            return;
+          }
+        }
+      }
+
+      const T* items_;
+      SubsetIterator subset_;
+      SubsetIterator subset_end_;
+      // item iterators are not always default constructible or assignable
+      std::optional<ItemIterator> item_;
+      std::optional<ItemIterator> item_end_;
+    };
+
+    GroupView(const T& items, const G& subsets, int group) :
+        items_(items), subsets_(subsets), group_(group) {}
+
+    Iterator begin() const {
+      auto&& view = subsets_.ViewOf(group_);
+      return Iterator(items_, view.begin(), view.end());
+    }
+
+    Iterator end() const {
+      auto&& view = subsets_.ViewOf(group_);
+      return Iterator(items_, view.end(), view.end());
+    }
+
+  private:
+    const T& items_;
+    const G& subsets_;
+    int group_;
+  };
+
+  /*
+   * Load from subset_of[item] and group_of[subset] arrays; -1 leaves an item
+   * or a subset unassigned. weights[item] is copied.
+   */
+  Hierarchy(const int* subset_of, int num_items, int num_subsets,
+            const int* group_of, int num_groups,
+            const int* weights) :
+      items_(T::FromAssignment(subset_of, num_items, num_subsets)),
+      subsets_(G::FromAssignment(group_of, num_subsets, num_groups)),
+      weights_(weights, weights + num_items),
+      subset_weights_(num_subsets, 0),
+      group_weights_(num_groups, 0)
+  {
+    for (int item = 0; item < num_items; item++) {
+      if (subset_of[item] != -1) {
+        subset_weights_[subset_of[item]] += weights_[item];
+      }
+    }
+    for (int subset = 0; subset < num_subsets; subset++) {
+      if (group_of[subset] != -1) {
+        group_weights_[group_of[subset]] += subset_weights_[subset];
+      }
+    }
+  }
+
+  Hierarchy(const Hierarchy&) = delete;
+  Hierarchy& operator=(const Hierarchy&) = delete;
+
+  int SubsetOf(int item) const {
+    return items_.SubsetOf(item);
+  }
+
+  int GroupOf(int subset) const {
+    return subsets_.SubsetOf(subset);
+  }
+
+  void AssignItem(int item, int subset) {
+    int prev_subset = items_.SubsetOf(item);
+    if (prev_subset == subset) {
+      return;
+    }
+    int weight = weights_[item];
+    if (prev_subset != -1) {
+      AddWeight(prev_subset, -weight);
+    }
+    if (subset != -1) {
+      AddWeight(subset, weight);
+    }
+    items_.Assign(item, subset);
+  }
+
+  void AssignSubset(int subset, int group) {
+    int prev_group = subsets_.SubsetOf(subset);
+    if (prev_group == group) {
+      return;
+    }
+    if (prev_group != -1) {
+      group_weights_[prev_group] -= subset_weights_[subset];
+    }
+    if (group != -1) {
+      group_weights_[group] += subset_weights_[subset];
+    }
+    subsets_.Assign(subset, group);
+  }
+
+  // items of subset
+  auto ViewOf(int subset) const -> decltype(std::declval<const T&>().ViewOf(0)) {
+    return items_.ViewOf(subset);
+  }
+
+  // subsets of group
+  auto SubsetsOf(int group) const -> decltype(std::declval<const G&>().ViewOf(0)) {
+    return subsets_.ViewOf(group);
+  }
+
+  // items of all subsets of group
+  GroupView GroupViewOf(int group) const {
+    return GroupView(items_, subsets_, group);
+  }
+
+  int WeightOf(int item) const { return weights_[item]; }
+  int SubsetWeight(int subset) const { return subset_weights_[subset]; }
+  int GroupWeight(int group) const { return group_weights_[group]; }
+
+  int num_subsets() const { return (int)subset_weights_.size(); }
+  int num_groups() const { return (int)group_weights_.size(); }
+
+private:
+  void AddWeight(int subset, int weight) {
+    subset_weights_[subset] += weight;
+    int group = subsets_.SubsetOf(subset);
+    if (group != -1) {
+      group_weights_[group] += weight;
+    }
+  }
+
+  T items_;
+  G subsets_;
+  std::vector<int> weights_;
+  std::vector<int> subset_weights_;
+  std::vector<int> group_weights_;
+};
@@ -1,6 +1,10 @@
 #pragma once
 
 #include <memory>
+#include <vector>
+
+#include "slice.h"
+#include "undo_log.h"
 
 class ItemTwine {
 private:
@@ -41,11 +45,11 @@ public:
 
       reference operator*() const { return curr_item_; }
 
-      bool operator==(const Iterator& that) {
+      bool operator==(const Iterator& that) const {
         return this->curr_item_ == that.curr_item_;
       }
 
-      bool operator!=(const Iterator& that) {
+      bool operator!=(const Iterator& that) const {
         return this->curr_item_ != that.curr_item_;
       }
 
@@ -77,11 +81,30 @@ public:
       item_data_(new ItemData[num_items]),
       subset_data_(new SubsetData[num_subsets]) {}
 
+  /*
+   * Bulk load from subset_of[item] array. Items are pushed in reverse order,
+   * so every list is linked in ascending order of items and is traversed
+   * forward through item_data_.
+   */
+  static ItemTwine FromAssignment(const int* subset_of, int num_items, int num_subsets) {
+    ItemTwine twine(num_items, num_subsets);
+    for (int item = num_items - 1; item >= 0; item--) {
+      if (subset_of[item] != -1) {
+        twine.PushItem(item, subset_of[item]);
+      }
+    }
+    return twine;
+  }
+
   void Assign(int item, int subset) {
-    if (item_data_[item].subset == subset) {
+    const ItemData& id = item_data_[item];
+    if (id.subset == subset) {
       return;
     }
-    if (item_data_[item].subset != -1) {
+    if (moves_.logging()) {
+      moves_.Push(Move{item, id.subset, id.prev_item, id.next_item});
+    }
+    if (id.subset != -1) {
       RemoveItem(item);
     }
     if (subset != -1) {
@@ -93,11 +116,44 @@ public:
     return SubsetView(item_data_.get(), subset_data_[subset].back_item);
   }
 
+  // splitting a list needs a walk over all of its items, so it is not split
+  typedef Slice<SubsetView::Iterator> SubsetSlice;
+  std::vector<SubsetSlice> SplitViewOf(int subset, int /*max_slices*/) const {
+    SubsetView view = ViewOf(subset);
+    return {SubsetSlice(view.begin(), view.end())};
+  }
+
   int SubsetOf(int item) const {
     return item_data_[item].subset;
   }
 
+  // for SubsetOfMany()
+  void PrefetchItem(int item) const {
+    __builtin_prefetch(&item_data_[item], 0/*read*/, 1);
+  }
+
+  // trial moves: Rollback() relinks items exactly as they were at Savepoint()
+  int Savepoint() {
+    return moves_.Savepoint();
+  }
+
+  void Rollback(int savepoint) {
+    moves_.Rollback(savepoint, [this](const Move& move) { Undo(move); });
+  }
+
+  void Release(int savepoint) {
+    moves_.Release(savepoint);
+  }
+
 private:
+  // item and its links before a logged Assign()
+  struct Move {
+    int item;
+    int subset;
+    int prev_item;
+    int next_item;
+  };
+
   // add item to the back of given subset
   void PushItem(int item, int subset) {
     item_data_[item].prev_item = -1;
@@ -128,7 +184,29 @@ private:
     item_data_[item].subset = -1;
   }
 
+  // inverse of the latest logged Assign(): item is relinked between its old neighbours
+  void Undo(const Move& move) {
+    int item = move.item;
+    if (item_data_[item].subset != -1) {
+      RemoveItem(item);
+    }
+    if (move.subset != -1) {
+      if (move.prev_item != -1) {
+        item_data_[move.prev_item].next_item = item;
+      } else {
+        subset_data_[move.subset].back_item = item;
+      }
+      if (move.next_item != -1) {
+        item_data_[move.next_item].prev_item = item;
+      }
+    }
+    item_data_[item].subset = move.subset;
+    item_data_[item].prev_item = move.prev_item;
+    item_data_[item].next_item = move.next_item;
+  }
+
   std::unique_ptr<ItemData[]> item_data_;
   std::unique_ptr<SubsetData[]> subset_data_;
+  MoveLog<Move> moves_;
 };
 
@@ -0,0 +1,17 @@
+#pragma once
+
+/*
+ * Batched SubsetOf(): out[i] = partition.SubsetOf(items[i]). Metadata of the
+ * item kLookupPrefetchDistance lookups ahead is prefetched through
+ * partition.PrefetchItem(), so that many cache misses are in flight at once.
+ */
+template<typename T>
+void SubsetOfMany(const T& partition, const int* items, int* out, int n) {
+  constexpr int kLookupPrefetchDistance = 16;
+  for (int i = 0; i < n; i++) {
+    if (i + kLookupPrefetchDistance < n) {
+      partition.PrefetchItem(items[i + kLookupPrefetchDistance]);
+    }
+    out[i] = partition.SubsetOf(items[i]);
+  }
+}
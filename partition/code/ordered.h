@@ -0,0 +1,520 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+/*
+ * Forest of B+ trees over distinct 64-bit keys, one tree per subset. Leaves of
+ * a tree are linked in key order and the tree remembers its front and back
+ * leaf, so the smallest and the largest key are found in O(1), insertion and
+ * removal take O(log n), and the k largest keys O(log n + k).
+ *
+ * Nodes of all trees come from two shared pools, one for leaves and one for
+ * inner nodes, and are addressed by index; released nodes are reused.
+ */
+class OrderedIndex {
+private:
+  static constexpr int kLeafCapacity = 60;
+  static constexpr int kInnerCapacity = 40;
+
+  // both node types have one spare slot for the key that overflows them
+  struct Leaf {
+    int num_keys;
+    int prev;
+    int next;
+    uint64_t keys[kLeafCapacity + 1];
+  };
+
+  struct Inner {
+    int num_children;
+    int children[kInnerCapacity + 1];
+    uint64_t max_keys[kInnerCapacity + 1]; // largest key under every child
+  };
+
+  struct Tree {
+    Tree() :
+        root(-1),
+        height(0),
+        front(-1),
+        back(-1) {}
+
+    int root;
+    int height; // 0 if root is a leaf
+    int front;  // leaf holding the smallest keys
+    int back;   // leaf holding the largest keys
+  };
+
+public:
+  explicit OrderedIndex(int num_trees) : trees_(num_trees) {}
+
+  bool Empty(int tree) const {
+    return trees_[tree].root == -1;
+  }
+
+  // tree must not be empty
+  uint64_t Min(int tree) const {
+    return leaves_[trees_[tree].front].keys[0];
+  }
+
+  uint64_t Max(int tree) const {
+    const Leaf& leaf = leaves_[trees_[tree].back];
+    return leaf.keys[leaf.num_keys - 1];
+  }
+
+  // calls f(key) from the largest key down, while f returns true
+  template<typename F>
+  void ForEachDescending(int tree, F f) const {
+    for (int node = trees_[tree].back; node != -1; node = leaves_[node].prev) {
+      const Leaf& leaf = leaves_[node];
+      for (int i = leaf.num_keys - 1; i >= 0; i--) {
+        if (!f(leaf.keys[i])) {
+          return;
+        }
+      }
+    }
+  }
+
+  // key must not be in tree
+  void Insert(int tree, uint64_t key) {
+    Tree& t = trees_[tree];
+    if (t.root == -1) {
+      int node = NewLeaf();
+      Leaf& leaf = leaves_[node];
+      leaf.num_keys = 1;
+      leaf.prev = -1;
+      leaf.next = -1;
+      leaf.keys[0] = key;
+      t.root = t.front = t.back = node;
+      t.height = 0;
+      return;
+    }
+    int sibling = InsertInto(t, t.root, t.height, key);
+    if (sibling != -1) {
+      int node = NewInner();
+      Inner& root = inners_[node];
+      root.num_children = 2;
+      root.children[0] = t.root;
+      root.max_keys[0] = MaxKey(t.root, t.height);
+      root.children[1] = sibling;
+      root.max_keys[1] = MaxKey(sibling, t.height);
+      t.root = node;
+      t.height++;
+    }
+  }
+
+  // key must be in tree
+  void Erase(int tree, uint64_t key) {
+    Tree& t = trees_[tree];
+    EraseFrom(t, t.root, t.height, key);
+    if (t.height == 0) {
+      if (leaves_[t.root].num_keys == 0) {
+        free_leaves_.push_back(t.root);
+        t = Tree();
+      }
+    } else if (inners_[t.root].num_children == 1) {
+      int root = t.root;
+      t.root = inners_[root].children[0];
+      t.height--;
+      free_inners_.push_back(root);
+    }
+  }
+
+  /*
+   * Bulk load of an empty tree from n keys in ascending order. Every level is
+   * split into nodes of equal size, as full as capacity allows.
+   */
+  void Load(int tree, const uint64_t* keys, int n) {
+    if (n == 0) {
+      return;
+    }
+    std::vector<int> level;
+    std::vector<uint64_t> max_keys;
+    int num_leaves = (n + kLeafCapacity - 1) / kLeafCapacity;
+    for (int j = 0; j < num_leaves; j++) {
+      int begin = int64_t(n) * j / num_leaves;
+      int end = int64_t(n) * (j + 1) / num_leaves;
+      int node = NewLeaf();
+      Leaf& leaf = leaves_[node];
+      leaf.num_keys = end - begin;
+      leaf.prev = level.empty() ? -1 : level.back();
+      leaf.next = -1;
+      std::copy(keys + begin, keys + end, leaf.keys);
+      if (!level.empty()) {
+        leaves_[level.back()].next = node;
+      }
+      level.push_back(node);
+      max_keys.push_back(keys[end - 1]);
+    }
+
+    Tree& t = trees_[tree];
+    t.front = level.front();
+    t.back = level.back();
+    t.height = 0;
+    while (level.size() > 1) {
+      std::vector<int> upper_level;
+      std::vector<uint64_t> upper_max_keys;
+      int num_nodes = (level.size() + kInnerCapacity - 1) / kInnerCapacity;
+      for (int j = 0; j < num_nodes; j++) {
+        int begin = level.size() * j / num_nodes;
+        int end = level.size() * (j + 1) / num_nodes;
+        int node = NewInner();
+        Inner& inner = inners_[node];
+        inner.num_children = end - begin;
+        std::copy(level.begin() + begin, level.begin() + end, inner.children);
+        std::copy(max_keys.begin() + begin, max_keys.begin() + end, inner.max_keys);
+        upper_level.push_back(node);
+        upper_max_keys.push_back(max_keys[end - 1]);
+      }
+      level.swap(upper_level);
+      max_keys.swap(upper_max_keys);
+      t.height++;
+    }
+    t.root = level[0];
+  }
+
+private:
+  int NewLeaf() {
+    if (!free_leaves_.empty()) {
+      int node = free_leaves_.back();
+      free_leaves_.pop_back();
+      return node;
+    }
+    leaves_.emplace_back();
+    return leaves_.size() - 1;
+  }
+
+  int NewInner() {
+    if (!free_inners_.empty()) {
+      int node = free_inners_.back();
+      free_inners_.pop_back();
+      return node;
+    }
+    inners_.emplace_back();
+    return inners_.size() - 1;
+  }
+
+  int SizeOf(int node, int height) const {
+    return (height == 0) ? leaves_[node].num_keys : inners_[node].num_children;
+  }
+
+  static int CapacityOf(int height) {
+    return (height == 0) ? kLeafCapacity : kInnerCapacity;
+  }
+
+  uint64_t MaxKey(int node, int height) const {
+    if (height == 0) {
+      const Leaf& leaf = leaves_[node];
+      return leaf.keys[leaf.num_keys - 1];
+    }
+    const Inner& inner = inners_[node];
+    return inner.max_keys[inner.num_children - 1];
+  }
+
+  // child whose key range covers key; keys above every range go to the last child
+  static int ChildFor(const Inner& inner, uint64_t key) {
+    int i = std::lower_bound(inner.max_keys, inner.max_keys + inner.num_children, key) - inner.max_keys;
+    return std::min(i, inner.num_children - 1);
+  }
+
+  // returns new right sibling of node if node was split, otherwise -1
+  int InsertInto(Tree& t, int node, int height, uint64_t key) {
+    if (height == 0) {
+      return InsertIntoLeaf(t, node, key);
+    }
+
+    // pools may grow below, so inners_[node] is not held by reference
+    int i = ChildFor(inners_[node], key);
+    int child = inners_[node].children[i];
+    int sibling = InsertInto(t, child, height - 1, key);
+    Inner* inner = &inners_[node];
+    inner->max_keys[i] = MaxKey(child, height - 1);
+    if (sibling == -1) {
+      return -1;
+    }
+    int n = inner->num_children;
+    std::copy_backward(inner->children + i + 1, inner->children + n, inner->children + n + 1);
+    std::copy_backward(inner->max_keys + i + 1, inner->max_keys + n, inner->max_keys + n + 1);
+    inner->children[i + 1] = sibling;
+    inner->max_keys[i + 1] = MaxKey(sibling, height - 1);
+    inner->num_children = ++n;
+    if (n <= kInnerCapacity) {
+      return -1;
+    }
+
+    int right = NewInner();
+    inner = &inners_[node];
+    Inner& r = inners_[right];
+    int half = n / 2;
+    r.num_children = n - half;
+    std::copy(inner->children + half, inner->children + n, r.children);
+    std::copy(inner->max_keys + half, inner->max_keys + n, r.max_keys);
+    inner->num_children = half;
+    return right;
+  }
+
+  int InsertIntoLeaf(Tree& t, int node, uint64_t key) {
+    Leaf* leaf = &leaves_[node];
+    int n = leaf->num_keys;
+    uint64_t* pos = std::lower_bound(leaf->keys, leaf->keys + n, key);
+    std::copy_backward(pos, leaf->keys + n, leaf->keys + n + 1);
+    *pos = key;
+    leaf->num_keys = ++n;
+    if (n <= kLeafCapacity) {
+      return -1;
+    }
+
+    int right = NewLeaf();
+    leaf = &leaves_[node];
+    Leaf& r = leaves_[right];
+    int half = n / 2;
+    r.num_keys = n - half;
+    std::copy(leaf->keys + half, leaf->keys + n, r.keys);
+    leaf->num_keys = half;
+    r.prev = node;
+    r.next = leaf->next;
+    if (leaf->next != -1) {
+      leaves_[leaf->next].prev = right;
+    } else {
+      t.back = right;
+    }
+    leaf->next = right;
+    return right;
+  }
+
+  // nothing is allocated while erasing, so references into pools stay valid
+  void EraseFrom(Tree& t, int node, int height, uint64_t key) {
+    if (height == 0) {
+      Leaf& leaf = leaves_[node];
+      uint64_t* pos = std::lower_bound(leaf.keys, leaf.keys + leaf.num_keys, key);
+      std::copy(pos + 1, leaf.keys + leaf.num_keys, pos);
+      leaf.num_keys--;
+      return;
+    }
+
+    Inner& inner = inners_[node];
+    int i = ChildFor(inner, key);
+    int child = inner.children[i];
+    EraseFrom(t, child, height - 1, key);
+    if ((SizeOf(child, height - 1) >= CapacityOf(height - 1) / 2) || (inner.num_children == 1)) {
+      if (SizeOf(child, height - 1) > 0) {
+        inner.max_keys[i] = MaxKey(child, height - 1);
+      }
+      return;
+    }
+    // underfull child is merged with a neighbour or takes some of its entries
+    Rebalance(t, inner, (i > 0) ? i - 1 : i, height - 1);
+  }
+
+  // rebalance children l and l+1 of inner; both are at given height
+  void Rebalance(Tree& t, Inner& inner, int l, int height) {
+    int left = inner.children[l];
+    int right = inner.children[l + 1];
+    int total = SizeOf(left, height) + SizeOf(right, height);
+    if (total <= CapacityOf(height)) {
+      if (height == 0) {
+        MergeLeaves(t, left, right);
+        free_leaves_.push_back(right);
+      } else {
+        MergeInners(left, right);
+        free_inners_.push_back(right);
+      }
+      int n = inner.num_children;
+      std::copy(inner.children + l + 2, inner.children + n, inner.children + l + 1);
+      std::copy(inner.max_keys + l + 2, inner.max_keys + n, inner.max_keys + l + 1);
+      inner.num_children--;
+    } else {
+      if (height == 0) {
+        ShiftLeaves(leaves_[left], leaves_[right], total / 2);
+      } else {
+        ShiftInners(inners_[left], inners_[right], total / 2);
+      }
+      inner.max_keys[l + 1] = MaxKey(right, height);
+    }
+    inner.max_keys[l] = MaxKey(left, height);
+  }
+
+  void MergeLeaves(Tree& t, int left, int right) {
+    Leaf& l = leaves_[left];
+    Leaf& r = leaves_[right];
+    std::copy(r.keys, r.keys + r.num_keys, l.keys + l.num_keys);
+    l.num_keys += r.num_keys;
+    l.next = r.next;
+    if (r.next != -1) {
+      leaves_[r.next].prev = left;
+    } else {
+      t.back = left;
+    }
+  }
+
+  void MergeInners(int left, int right) {
+    Inner& l = inners_[left];
+    Inner& r = inners_[right];
+    std::copy(r.children, r.children + r.num_children, l.children + l.num_children);
+    std::copy(r.max_keys, r.max_keys + r.num_children, l.max_keys + l.num_children);
+    l.num_children += r.num_children;
+  }
+
+  // move entries across the boundary so that l ends up with left_size of them
+  static void ShiftLeaves(Leaf& l, Leaf& r, int left_size) {
+    if (l.num_keys < left_size) {
+      int k = left_size - l.num_keys;
+      std::copy(r.keys, r.keys + k, l.keys + l.num_keys);
+      std::copy(r.keys + k, r.keys + r.num_keys, r.keys);
+      l.num_keys += k;
+      r.num_keys -= k;
+    } else {
+      int k = l.num_keys - left_size;
+      std::copy_backward(r.keys, r.keys + r.num_keys, r.keys + r.num_keys + k);
+      std::copy(l.keys + left_size, l.keys + l.num_keys, r.keys);
+      l.num_keys -= k;
+      r.num_keys += k;
+    }
+  }
+
+  static void ShiftInners(Inner& l, Inner& r, int left_size) {
+    if (l.num_children < left_size) {
+      int k = left_size - l.num_children;
+      std::copy(r.children, r.children + k, l.children + l.num_children);
+      std::copy(r.max_keys, r.max_keys + k, l.max_keys + l.num_children);
+      std::copy(r.children + k, r.children + r.num_children, r.children);
+      std::copy(r.max_keys + k, r.max_keys + r.num_children, r.max_keys);
+      l.num_children += k;
+      r.num_children -= k;
+    } else {
+      int k = l.num_children - left_size;
+      std::copy_backward(r.children, r.children + r.num_children, r.children + r.num_children + k);
+      std::copy_backward(r.max_keys, r.max_keys + r.num_children, r.max_keys + r.num_children + k);
+      std::copy(l.children + left_size, l.children + l.num_children, r.children);
+      std::copy(l.max_keys + left_size, l.max_keys + l.num_children, r.max_keys);
+      l.num_children -= k;
+      r.num_children += k;
+    }
+  }
+
+  std::vector<Tree> trees_;
+  std::vector<Leaf> leaves_;
+  std::vector<Inner> inners_;
+  std::vector<int> free_leaves_;
+  std::vector<int> free_inners_;
+};
+
+/*
+ * Partition of type T with an OrderedIndex on top of it. Items of every
+ * subset are ordered by (weight, item id), or by item id alone when no
+ * weights are given, so the lightest and the heaviest item of a subset and
+ * its top-k heaviest items are found without walking the subset. Assign()
+ * keeps the index in sync at the cost of one removal and one insertion.
+ *
+ * Weights are non-negative and fixed for the lifetime of the partition.
+ */
+template<typename T>
+class Ordered {
+public:
+  typedef typename T::SubsetView SubsetView;
+
+  Ordered(int num_items, int num_subsets, std::vector<int> weights = {}) :
+      partition_(num_items, num_subsets),
+      index_(num_subsets),
+      weights_(std::move(weights)) {}
+
+  /*
+   * Bulk load from subset_of[item] array: T is bulk loaded, keys are
+   * counting-sorted by subset, and the tree of every subset is built bottom-up
+   * from its sorted keys.
+   */
+  static Ordered FromAssignment(const int* subset_of, int num_items, int num_subsets,
+                                std::vector<int> weights = {}) {
+    Ordered ordered(T::FromAssignment(subset_of, num_items, num_subsets),
+                    num_subsets, std::move(weights));
+
+    std::vector<int> offsets(num_subsets + 1, 0);
+    for (int item = 0; item < num_items; item++) {
+      if (subset_of[item] != -1) {
+        offsets[subset_of[item] + 1]++;
+      }
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    std::vector<uint64_t> keys(offsets.back());
+    std::vector<int> cursor(offsets.begin(), offsets.end() - 1);
+    for (int item = 0; item < num_items; item++) {
+      if (subset_of[item] != -1) {
+        keys[cursor[subset_of[item]]++] = ordered.KeyOf(item);
+      }
+    }
+    for (int s = 0; s < num_subsets; s++) {
+      std::sort(keys.begin() + offsets[s], keys.begin() + offsets[s + 1]);
+      ordered.index_.Load(s, keys.data() + offsets[s], offsets[s + 1] - offsets[s]);
+    }
+    return ordered;
+  }
+
+  void Assign(int item, int subset) {
+    int old_subset = partition_.SubsetOf(item);
+    if (old_subset == subset) {
+      return;
+    }
+    partition_.Assign(item, subset);
+    if (old_subset != -1) {
+      index_.Erase(old_subset, KeyOf(item));
+    }
+    if (subset != -1) {
+      index_.Insert(subset, KeyOf(item));
+    }
+  }
+
+  SubsetView ViewOf(int subset) const {
+    return partition_.ViewOf(subset);
+  }
+
+  int SubsetOf(int item) const {
+    return partition_.SubsetOf(item);
+  }
+
+  void PrefetchItem(int item) const {
+    partition_.PrefetchItem(item);
+  }
+
+  // first item of subset in (weight, item id) order, -1 if subset is empty
+  int Lowest(int subset) const {
+    return index_.Empty(subset) ? -1 : ItemOf(index_.Min(subset));
+  }
+
+  // last item of subset in (weight, item id) order, -1 if subset is empty
+  int Highest(int subset) const {
+    return index_.Empty(subset) ? -1 : ItemOf(index_.Max(subset));
+  }
+
+  // up to k last items of subset, highest first
+  void TopK(int subset, int k, std::vector<int>& out) const {
+    out.clear();
+    if (k <= 0) {
+      return;
+    }
+    index_.ForEachDescending(subset, [&](uint64_t key) {
+      out.push_back(ItemOf(key));
+      return int(out.size()) < k;
+    });
+  }
+
+private:
+  Ordered(T&& partition, int num_subsets, std::vector<int> weights) :
+      partition_(std::move(partition)),
+      index_(num_subsets),
+      weights_(std::move(weights)) {}
+
+  uint64_t KeyOf(int item) const {
+    uint64_t weight = weights_.empty() ? 0 : weights_[item];
+    return (weight << 32) | uint32_t(item);
+  }
+
+  static int ItemOf(uint64_t key) {
+    return int(uint32_t(key));
+  }
+
+  T partition_;
+  OrderedIndex index_;
+  std::vector<int> weights_;
+};
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Worker threads which outlive a single parallel call, so that repeated
+ * calls (e.g. one per k-means iteration) do not pay for thread creation.
+ * Run() calls task(w) for every w in [0, num_threads), w = 0 on the calling
+ * thread, and returns when all of them have returned. Threads are created on
+ * demand and parked on a condition variable between calls. Calls from
+ * different threads are serialized; a call made from inside a task runs all
+ * of its tasks on the calling thread, as the workers are busy.
+ */
+class WorkerPool {
+public:
+  static WorkerPool& Instance() {
+    static WorkerPool pool;
+    return pool;
+  }
+
+  ~WorkerPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+      generation_++;
+    }
+    start_.notify_all();
+    for (std::thread& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  void Run(int num_threads, const std::function<void(int)>& task) {
+    if (num_threads <= 1 || InTask()) {
+      for (int w = 0; w < num_threads; w++) {
+        task(w);
+      }
+      return;
+    }
+    std::lock_guard<std::mutex> run_lock(run_mutex_);
+    InTask() = true;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while ((int)threads_.size() < num_threads - 1) {
+      int worker = threads_.size() + 1;
+      // new thread sees generation_ change below and joins this call
+      threads_.emplace_back([this, worker, generation = generation_]() { Work(worker, generation); });
+    }
+    task_ = &task;
+    num_threads_ = num_threads;
+    num_running_ = num_threads - 1;
+    generation_++;
+    lock.unlock();
+    start_.notify_all();
+
+    task(0);
+
+    lock.lock();
+    done_.wait(lock, [this]() { return num_running_ == 0; });
+    InTask() = false;
+  }
+
+private:
+  WorkerPool() : task_(nullptr), num_threads_(0), num_running_(0), generation_(0), stop_(false) {}
+
+  // true on a thread which is running a task of Run()
+  static bool& InTask() {
+    static thread_local bool in_task = false;
+    return in_task;
+  }
+
+  void Work(int worker, uint64_t generation) {
+    InTask() = true;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+      start_.wait(lock, [&]() { return generation_ != generation; });
+      generation = generation_;
+      if (stop_) {
+        return;
+      }
+      if (worker >= num_threads_) {
+        continue; // this call needs fewer threads
+      }
+      const std::function<void(int)>* task = task_;
+      lock.unlock();
+      (*task)(worker);
+      lock.lock();
+      if (--num_running_ == 0) {
+        done_.notify_one();
+      }
+    }
+  }
+
+  std::mutex run_mutex_; // held by the caller for the whole Run()
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  std::vector<std::thread> threads_;
+  const std::function<void(int)>* task_;
+  int num_threads_;
+  int num_running_;
+  uint64_t generation_; // bumped by every Run() and by shutdown
+  bool stop_;
+};
+
+/*
+ * Call fn(worker, subset, slice) for every slice of every subset using
+ * num_threads worker threads. Each subset is split into up to num_threads
+ * slices, so that a single large subset is processed by several threads.
+ * Slices are handed out dynamically; worker is in [0, num_threads) and can be
+ * used to index per-thread accumulators. Threads come from WorkerPool.
+ */
+template<typename T, typename Fn>
+void ForEachSubsetParallel(const T& partition, int num_subsets, int num_threads, Fn fn) {
+  typedef typename decltype(partition.SplitViewOf(0, 1))::value_type SliceType;
+  struct Task {
+    int subset;
+    SliceType slice;
+  };
+
+  std::vector<Task> tasks;
+  for (int subset = 0; subset < num_subsets; subset++) {
+    for (const SliceType& slice : partition.SplitViewOf(subset, num_threads)) {
+      tasks.push_back(Task{subset, slice});
+    }
+  }
+
+  std::atomic<size_t> next_task(0);
+  WorkerPool::Instance().Run(num_threads, [&](int w) {
+    size_t t;
+    while ((t = next_task.fetch_add(1, std::memory_order_relaxed)) < tasks.size()) {
+      fn(w, tasks[t].subset, tasks[t].slice);
+    }
+  });
+}
@@ -0,0 +1,531 @@
+#pragma once
+
+#include <memory>
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "slice.h"
+#include "undo_log.h"
+
+/*
+ * Partition assembled from compile-time policies:
+ *
+ *   Storage     - how members of a subset are stored and removed:
+ *                 VectorStorage<Removal>, ChunkStorage<kChunkCapacity>,
+ *                 ListStorage;
+ *   Layout      - how per-item metadata (subset and storage slot) is laid
+ *                 out: AoS or SoA;
+ *   SubsetIndex - integer type holding subset of an item, e.g. int16_t
+ *                 halves metadata of AoS layouts with few subsets.
+ *
+ * Every combination provides the same interface as the hand-written
+ * containers, so benchmark.cc registers the whole cartesian product.
+ */
+
+////////////////////////////////////////////////////////////////////////////////
+// Item metadata layouts
+
+// array of structures: subset and slot of an item share a cache line
+struct AoS {
+  static const char* Name() { return "AoS"; }
+
+  template<typename SubsetIndex, typename Slot>
+  class Items {
+  public:
+    Items(int num_items) : entries_(new Entry[num_items]) {}
+
+    SubsetIndex& subset(int item) { return entries_[item].subset; }
+    const SubsetIndex& subset(int item) const { return entries_[item].subset; }
+    Slot& slot(int item) { return entries_[item].slot; }
+    const Slot& slot(int item) const { return entries_[item].slot; }
+
+  private:
+    struct Entry {
+      SubsetIndex subset;
+      Slot slot;
+    };
+
+    std::unique_ptr<Entry[]> entries_;
+  };
+};
+
+// structure of arrays: SubsetOf() touches only the dense array of subsets
+struct SoA {
+  static const char* Name() { return "SoA"; }
+
+  template<typename SubsetIndex, typename Slot>
+  class Items {
+  public:
+    Items(int num_items) :
+        subsets_(new SubsetIndex[num_items]),
+        slots_(new Slot[num_items]) {}
+
+    SubsetIndex& subset(int item) { return subsets_[item]; }
+    const SubsetIndex& subset(int item) const { return subsets_[item]; }
+    Slot& slot(int item) { return slots_[item]; }
+    const Slot& slot(int item) const { return slots_[item]; }
+
+  private:
+    std::unique_ptr<SubsetIndex[]> subsets_;
+    std::unique_ptr<Slot[]> slots_;
+  };
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Removal strategies of VectorStorage
+
+// fill the hole with the last member: O(1), order is not preserved
+struct SwapRemove {
+  static const char* Name() { return "Swap"; }
+  static constexpr bool kHasHoles = false;
+
+  template<typename Items>
+  static void Remove(std::vector<int>& members, int& /*num_holes*/, Items& items, int item) {
+    int pos = items.slot(item);
+    int back_item = members.back();
+    members[pos] = back_item;
+    items.slot(back_item) = pos;
+    members.pop_back();
+  }
+};
+
+// leave a hole, squeeze holes out once they are the majority: keeps order
+struct LazyRemove {
+  static const char* Name() { return "Lazy"; }
+  static constexpr bool kHasHoles = true;
+  static constexpr int kHole = -1;
+
+  template<typename Items>
+  static void Remove(std::vector<int>& members, int& num_holes, Items& items, int item) {
+    members[items.slot(item)] = kHole;
+    num_holes++;
+    if (2 * num_holes > (int)members.size()) {
+      int size = 0;
+      for (int member : members) {
+        if (member != kHole) {
+          items.slot(member) = size;
+          members[size++] = member;
+        }
+      }
+      members.resize(size);
+      num_holes = 0;
+    }
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Storages
+
+// members of every subset in a std::vector, slot is position in it
+template<typename Removal>
+struct VectorStorage {
+  static std::string Name() { return std::string("Vector") + Removal::Name(); }
+
+  typedef int Slot;
+
+  template<typename Items>
+  class Subsets {
+  public:
+    typedef std::vector<int>::const_iterator MemberIterator;
+
+    class SubsetView {
+    public:
+      class Iterator {
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = int;
+        using pointer           = int*;
+        using reference         = int;
+
+        Iterator(MemberIterator it, MemberIterator end) : it_(it), end_(end) {
+          SkipHoles();
+        }
+
+        reference operator*() const { return *it_; }
+
+        Iterator& operator++() {
+          ++it_;
+          SkipHoles();
+          return *this;
+        }
+
+        Iterator operator++(int) {
+          Iterator tmp = *this;
+          ++(*this);
+          return tmp;
+        }
+
+        bool operator== (const Iterator& that) const { return this->it_ == that.it_; }
+        bool operator!= (const Iterator& that) const { return this->it_ != that.it_; }
+
+      private:
+        void SkipHoles() {
+          if constexpr (Removal::kHasHoles) {
+            while ((it_ != end_) && (*it_ == LazyRemove::kHole)) {
+              ++it_;
+            }
+          }
+        }
+
+        MemberIterator it_;
+        MemberIterator end_;
+      };
+
+      SubsetView(const std::vector<int>& members) : members_(members) {}
+
+      Iterator begin() const { return Iterator(members_.begin(), members_.end()); }
+      Iterator end() const { return Iterator(members_.end(), members_.end()); }
+
+    private:
+      const std::vector<int>& members_;
+    };
+
+    Subsets(int /*num_items*/, int num_subsets) :
+        members_(num_subsets),
+        num_holes_(num_subsets, 0) {}
+
+    void Insert(Items& items, int item, int subset) {
+      items.slot(item) = members_[subset].size();
+      members_[subset].push_back(item);
+    }
+
+    void Remove(Items& items, int item, int subset) {
+      Removal::Remove(members_[subset], num_holes_[subset], items, item);
+    }
+
+    SubsetView ViewOf(const Items& /*items*/, int subset) const {
+      return SubsetView(members_[subset]);
+    }
+
+  private:
+    std::vector<std::vector<int>> members_;
+    std::vector<int> num_holes_;
+  };
+};
+
+// ChunkTwine scheme with chunks addressed by index, slot is (chunk, chpos)
+template<int kChunkCapacity>
+struct ChunkStorage {
+  static std::string Name() { return "Chunk" + std::to_string(kChunkCapacity); }
+
+  struct Slot {
+    int chunk;
+    int chpos;
+  };
+
+  template<typename Items>
+  class Subsets {
+  private:
+    struct Chunk {
+      Chunk() : next(-1), num_items(0) {}
+
+      int next;
+      int num_items;
+      std::array<int, kChunkCapacity> items;
+    };
+
+  public:
+    class SubsetView {
+    public:
+      class Iterator {
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = int;
+        using pointer           = int*;
+        using reference         = int;
+
+        Iterator(const Chunk* pool, int chunk, int chpos) :
+            pool_(pool), chunk_(chunk), chpos_(chpos)
+        {
+          Prefetch();
+        }
+
+        reference operator*() const { return pool_[chunk_].items[chpos_]; }
+
+        Iterator& operator++() {
+          chpos_++;
+          if (chpos_ >= pool_[chunk_].num_items) {
+            chunk_ = pool_[chunk_].next;
+            chpos_ = 0;
+            Prefetch();
+          }
+          return *this;
+        }
+
+        Iterator operator++(int) {
+          Iterator tmp = *this;
+          ++(*this);
+          return tmp;
+        }
+
+        bool operator== (const Iterator& that) const {
+          return (this->chunk_ == that.chunk_) && (this->chpos_ == that.chpos_);
+        }
+
+        bool operator!= (const Iterator& that) const {
+          return (this->chunk_ != that.chunk_) || (this->chpos_ != that.chpos_);
+        }
+
+      private:
+        void Prefetch() {
+          if ((chunk_ != -1) && (pool_[chunk_].next != -1)) {
+            __builtin_prefetch(&pool_[pool_[chunk_].next], 0/*read*/, 1);
+          }
+        }
+
+        const Chunk* pool_;
+        int chunk_;
+        int chpos_;
+      };
+
+      SubsetView(const Chunk* pool, int back) : pool_(pool), back_(back) {}
+
+      Iterator begin() const { return Iterator(pool_, back_, 0); }
+      Iterator end() const { return Iterator(pool_, -1, 0); }
+
+    private:
+      const Chunk* pool_;
+      int back_;
+    };
+
+    Subsets(int num_items, int num_subsets) :
+        pool_(new Chunk[num_subsets + (num_items-num_subsets)/kChunkCapacity]),
+        back_(num_subsets, -1),
+        free_(-1)
+    {
+      for (int i = num_subsets + (num_items-num_subsets)/kChunkCapacity - 1; i >= 0; i--) {
+        pool_[i].next = free_;
+        free_ = i;
+      }
+    }
+
+    void Insert(Items& items, int item, int subset) {
+      int chunk = back_[subset];
+      if ((chunk == -1) || (pool_[chunk].num_items == kChunkCapacity)) {
+        chunk = free_;
+        free_ = pool_[chunk].next;
+        pool_[chunk].next = back_[subset];
+        pool_[chunk].num_items = 0;
+        back_[subset] = chunk;
+      }
+      int chpos = pool_[chunk].num_items++;
+      pool_[chunk].items[chpos] = item;
+      items.slot(item) = Slot{chunk, chpos};
+    }
+
+    void Remove(Items& items, int item, int subset) {
+      int back = back_[subset];
+      int back_item = pool_[back].items[--pool_[back].num_items];
+      if (pool_[back].num_items == 0) {
+        back_[subset] = pool_[back].next;
+        pool_[back].next = free_;
+        free_ = back;
+      }
+      if (item != back_item) {
+        // move back item to the position previously occupied by item
+        Slot slot = items.slot(item);
+        pool_[slot.chunk].items[slot.chpos] = back_item;
+        items.slot(back_item) = slot;
+      }
+    }
+
+    SubsetView ViewOf(const Items& /*items*/, int subset) const {
+      return SubsetView(pool_.get(), back_[subset]);
+    }
+
+  private:
+    std::unique_ptr<Chunk[]> pool_;
+    std::vector<int> back_;
+    int free_;
+  };
+};
+
+// intrusive doubly linked list through item slots, as in ItemTwine
+struct ListStorage {
+  static std::string Name() { return "List"; }
+
+  struct Slot {
+    int prev;
+    int next;
+  };
+
+  template<typename Items>
+  class Subsets {
+  public:
+    class SubsetView {
+    public:
+      class Iterator {
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = int;
+        using pointer           = int*;
+        using reference         = int;
+
+        Iterator(const Items* items, int item) : items_(items), item_(item) {}
+
+        reference operator*() const { return item_; }
+
+        Iterator& operator++() {
+          item_ = items_->slot(item_).next;
+          return *this;
+        }
+
+        Iterator operator++(int) {
+          Iterator tmp = *this;
+          ++(*this);
+          return tmp;
+        }
+
+        bool operator== (const Iterator& that) const { return this->item_ == that.item_; }
+        bool operator!= (const Iterator& that) const { return this->item_ != that.item_; }
+
+      private:
+        const Items* items_;
+        int item_;
+      };
+
+      SubsetView(const Items* items, int front) : items_(items), front_(front) {}
+
+      Iterator begin() const { return Iterator(items_, front_); }
+      Iterator end() const { return Iterator(items_, -1); }
+
+    private:
+      const Items* items_;
+      int front_;
+    };
+
+    Subsets(int /*num_items*/, int num_subsets) : front_(num_subsets, -1) {}
+
+    void Insert(Items& items, int item, int subset) {
+      int front = front_[subset];
+      items.slot(item) = Slot{-1, front};
+      if (front != -1) {
+        items.slot(front).prev = item;
+      }
+      front_[subset] = item;
+    }
+
+    void Remove(Items& items, int item, int subset) {
+      Slot slot = items.slot(item);
+      if (slot.prev != -1) {
+        items.slot(slot.prev).next = slot.next;
+      } else {
+        front_[subset] = slot.next;
+      }
+      if (slot.next != -1) {
+        items.slot(slot.next).prev = slot.prev;
+      }
+    }
+
+    SubsetView ViewOf(const Items& items, int subset) const {
+      return SubsetView(&items, front_[subset]);
+    }
+
+  private:
+    std::vector<int> front_;
+  };
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+template<typename Storage, typename Layout, typename SubsetIndex>
+class Partition {
+private:
+  typedef typename Layout::template Items<SubsetIndex, typename Storage::Slot> Items;
+  typedef typename Storage::template Subsets<Items> Subsets;
+
+  struct Move {
+    int item;
+    int subset; // before the move
+  };
+
+public:
+  typedef typename Subsets::SubsetView SubsetView;
+
+  // e.g. "Partition/Chunk123/SoA/16"
+  static std::string Name() {
+    return "Partition/" + std::string(Storage::Name()) + "/" + Layout::Name() +
+           "/" + std::to_string(8 * sizeof(SubsetIndex));
+  }
+
+  Partition(int num_items, int num_subsets) :
+      items_(num_items),
+      subsets_(num_items, num_subsets)
+  {
+    if (num_subsets - 1 > std::numeric_limits<SubsetIndex>::max()) {
+      throw std::length_error(Name() + ": too many subsets");
+    }
+    for (int item = 0; item < num_items; item++) {
+      items_.subset(item) = -1;
+    }
+  }
+
+  static Partition FromAssignment(const int* subset_of, int num_items, int num_subsets) {
+    Partition partition(num_items, num_subsets);
+    for (int item = 0; item < num_items; item++) {
+      partition.Assign(item, subset_of[item]);
+    }
+    return partition;
+  }
+
+  SubsetView ViewOf(int subset) const {
+    return subsets_.ViewOf(items_, subset);
+  }
+
+  typedef Slice<typename SubsetView::Iterator> SubsetSlice;
+  std::vector<SubsetSlice> SplitViewOf(int subset, int /*max_slices*/) const {
+    SubsetView view = ViewOf(subset);
+    return {SubsetSlice(view.begin(), view.end())};
+  }
+
+  int SubsetOf(int item) const {
+    return items_.subset(item);
+  }
+
+  // for SubsetOfMany()
+  void PrefetchItem(int item) const {
+    __builtin_prefetch(&items_.subset(item), 0/*read*/, 1);
+  }
+
+  void Assign(int item, int subset) {
+    int curr_subset = items_.subset(item);
+    if (curr_subset == subset) {
+      return;
+    }
+    if (moves_.logging()) {
+      moves_.Push(Move{item, curr_subset});
+    }
+    if (curr_subset != -1) {
+      subsets_.Remove(items_, item, curr_subset);
+    }
+    items_.subset(item) = subset;
+    if (subset != -1) {
+      subsets_.Insert(items_, item, subset);
+    }
+  }
+
+  // trial moves, undone by re-assigning items backwards
+  int Savepoint() {
+    return moves_.Savepoint();
+  }
+
+  void Rollback(int savepoint) {
+    moves_.Rollback(savepoint, [this](const Move& move) { Assign(move.item, move.subset); });
+  }
+
+  void Release(int savepoint) {
+    moves_.Release(savepoint);
+  }
+
+private:
+  Items items_;
+  Subsets subsets_;
+  MoveLog<Move> moves_;
+};
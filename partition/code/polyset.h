@@ -2,8 +2,12 @@
 
 #include <set>
 #include <unordered_set>
+#include <vector>
 #include <tsl/hopscotch_set.h>
 
+#include "slice.h"
+#include "undo_log.h"
+
 template<typename SetType>
 class PolySet {
 public:
@@ -11,9 +15,26 @@ public:
       item_data_(new ItemData[num_items]),
       subset_data_(new SubsetData[num_subsets]) {}
 
+  // bulk load from subset_of[item] array; items arrive in ascending order
+  static PolySet FromAssignment(const int* subset_of, int num_items, int num_subsets) {
+    PolySet polyset(num_items, num_subsets);
+    for (int item = 0; item < num_items; item++) {
+      int subset = subset_of[item];
+      if (subset != -1) {
+        SetType& items = polyset.subset_data_[subset].items;
+        items.insert(items.end(), item);
+        polyset.item_data_[item].subset = subset;
+      }
+    }
+    return polyset;
+  }
+
   void Assign(int item, int subset) {
     int curr_subset = item_data_[item].subset;
     if (curr_subset != subset) {
+      if (moves_.logging()) {
+        moves_.Push(Move{item, curr_subset});
+      }
       if (curr_subset != -1) {
         subset_data_[curr_subset].items.erase(item);
       }
@@ -29,10 +50,38 @@ public:
     return subset_data_[subset].items;
   }
 
+  // set iterators are not random access, so every subset is a single slice
+  typedef Slice<typename SetType::const_iterator> SubsetSlice;
+  std::vector<SubsetSlice> SplitViewOf(int subset, int /*max_slices*/) const {
+    const SetType& items = subset_data_[subset].items;
+    return {SubsetSlice(items.begin(), items.end())};
+  }
+
   int SubsetOf(int item) const {
     return item_data_[item].subset;
   }
 
+  // for SubsetOfMany()
+  void PrefetchItem(int item) const {
+    __builtin_prefetch(&item_data_[item], 0/*read*/, 1);
+  }
+
+  /*
+   * Trial moves. Sets have no layout worth restoring, so the log holds
+   * previous subsets of moved items and Rollback() re-assigns them backwards.
+   */
+  int Savepoint() {
+    return moves_.Savepoint();
+  }
+
+  void Rollback(int savepoint) {
+    moves_.Rollback(savepoint, [this](const Move& move) { Assign(move.item, move.subset); });
+  }
+
+  void Release(int savepoint) {
+    moves_.Release(savepoint);
+  }
+
 private:
   struct ItemData {
     ItemData() : subset(-1) {}
@@ -43,8 +92,14 @@ private:
     SetType items;
   };
 
+  struct Move {
+    int item;
+    int subset; // before the move
+  };
+
   std::unique_ptr<ItemData[]> item_data_;
   std::unique_ptr<SubsetData[]> subset_data_;
+  MoveLog<Move> moves_;
 };
 
 typedef PolySet<std::set<int>>           PolyRbSet;
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <memory>
+#include <array>
+#include <algorithm>
+#include <vector>
+
+#include "chunk_twine.h"
+
+/*
+ * ChunkTwine where every item is a member of up to kMaxReplicas distinct
+ * subsets at once (replicas of a shard on different servers). Chunks, chunk
+ * lists and subset views are ChunkTwine's own; ItemData holds one
+ * (subset, chunk, chpos) slot per replica, so all replicas of an item are
+ * found with a single lookup instead of one per separate partition.
+ *
+ * Used slots are kept at the front of ItemData.replicas. When a back item is
+ * moved into a hole, its slot for that subset is found by scanning at most
+ * kMaxReplicas slots.
+ */
+template<int kChunkCapacity, int kMaxReplicas>
+class ReplicaTwine {
+private:
+  typedef ChunkTwine<kChunkCapacity> Twine;
+  typedef typename Twine::Chunk Chunk;
+
+  struct Replica {
+    Replica() :
+        chunk(nullptr),
+        chpos(-1),
+        subset(-1) {}
+
+    Chunk* chunk;
+    int chpos; // position inside Chunk.items
+    int subset;
+  };
+
+  struct ItemData {
+    ItemData() : num_replicas(0) {}
+
+    std::array<Replica, kMaxReplicas> replicas;
+    int num_replicas;
+  };
+
+  struct SubsetData {
+    SubsetData() : back(nullptr) {}
+
+    Chunk* back;
+  };
+
+public:
+  typedef typename Twine::SubsetView SubsetView;
+
+  SubsetView ViewOf(int subset) const {
+    return SubsetView(subset_data_[subset].back);
+  }
+
+  ReplicaTwine(int num_items, int num_subsets) :
+    item_data_(new ItemData[num_items]),
+    subset_data_(new SubsetData[num_subsets]),
+    free_(nullptr)
+  {
+    // every subset has at most one partially filled chunk, as in ChunkTwine
+    int num_chunks = num_subsets + (num_items*kMaxReplicas - num_subsets)/kChunkCapacity;
+    chunk_pool_.reset(new Chunk[num_chunks]);
+    for (int i = 0; i < num_chunks; i++) {
+      Twine::PushChunk(&free_, &chunk_pool_[i]);
+    }
+  }
+
+  int NumReplicas(int item) const {
+    return item_data_[item].num_replicas;
+  }
+
+  // subset holding replica #replica of item, replica < NumReplicas(item)
+  int SubsetOf(int item, int replica) const {
+    return item_data_[item].replicas[replica].subset;
+  }
+
+  bool IsMember(int item, int subset) const {
+    return FindReplica(item_data_[item], subset) != -1;
+  }
+
+  // false if item is already in subset or has kMaxReplicas replicas
+  bool AddReplica(int item, int subset) {
+    ItemData& id = item_data_[item];
+    if ((id.num_replicas == kMaxReplicas) || (FindReplica(id, subset) != -1)) {
+      return false;
+    }
+    Include(item, id.replicas[id.num_replicas], subset);
+    id.num_replicas++;
+    return true;
+  }
+
+  // false if item is not in subset
+  bool RemoveReplica(int item, int subset) {
+    ItemData& id = item_data_[item];
+    int replica = FindReplica(id, subset);
+    if (replica == -1) {
+      return false;
+    }
+    Exclude(id.replicas[replica]);
+    id.num_replicas--;
+    id.replicas[replica] = id.replicas[id.num_replicas];
+    id.replicas[id.num_replicas] = Replica();
+    return true;
+  }
+
+  // move replica of item from one subset to another, keeping its slot
+  bool MoveReplica(int item, int from_subset, int to_subset) {
+    ItemData& id = item_data_[item];
+    int replica = FindReplica(id, from_subset);
+    if ((replica == -1) || (FindReplica(id, to_subset) != -1)) {
+      return false;
+    }
+    Exclude(id.replicas[replica]);
+    Include(item, id.replicas[replica], to_subset);
+    return true;
+  }
+
+private:
+  static int FindReplica(const ItemData& id, int subset) {
+    for (int r = 0; r < id.num_replicas; r++) {
+      if (id.replicas[r].subset == subset) {
+        return r;
+      }
+    }
+    return -1;
+  }
+
+  // append replica slot rs of item to the back chunk of subset
+  void Include(int item, Replica& rs, int subset) {
+    Chunk* chunk = subset_data_[subset].back;
+    if (!chunk || (chunk->num_items == kChunkCapacity)) {
+      chunk = Twine::PopChunk(&free_);
+      chunk->num_items = 0;
+      Twine::PushChunk(&subset_data_[subset].back, chunk);
+    }
+    rs.subset = subset;
+    rs.chunk = chunk;
+    rs.chpos = chunk->num_items++;
+    chunk->items[rs.chpos] = item;
+  }
+
+  // remove replica slot rs from its subset, filling the hole with the back item
+  void Exclude(Replica& rs) {
+    Chunk* back_chunk = subset_data_[rs.subset].back;
+    back_chunk->num_items--;
+    int back_item = back_chunk->items[back_chunk->num_items];
+    if (back_chunk->num_items == 0) {
+      Twine::PopChunk(&subset_data_[rs.subset].back);
+      Twine::PushChunk(&free_, back_chunk);
+    }
+
+    Replica& back_rs = item_data_[back_item].replicas[FindReplica(item_data_[back_item], rs.subset)];
+    if (&back_rs != &rs) {
+      rs.chunk->items[rs.chpos] = back_item;
+      back_rs.chunk = rs.chunk;
+      back_rs.chpos = rs.chpos;
+    }
+
+    rs = Replica();
+  }
+
+  std::unique_ptr<ItemData[]> item_data_;
+  std::unique_ptr<SubsetData[]> subset_data_;
+  std::unique_ptr<Chunk[]> chunk_pool_;
+  Chunk* free_;
+};
@@ -2,15 +2,27 @@
 set -euo pipefail
 
 make
-for bench in ops layout kmeans balancer; do
-  rm -f ${bench}.results
-  for impl in PolyRbSet PolyHashSet PolyHopscotchSet ItemTwine ChunkTwine Carousel; do
-    for repeat in $(seq 1 7); do
-      echo ${bench} ${impl} ${repeat}
-    done
+
+# dimensionality of points in kmeans-md, e.g. KMEANS_DIMS=64 ./run.sh
+dims=${KMEANS_DIMS:-128}
+
+# every registered unit, 7 times each in random order; the list comes from
+# the binary, so it always matches what benchmark.cc registers
+units=$(./benchmark --list)
+echo "${units}" | while read bench impl; do
+  rm -f ${bench}.results ${bench}.policies.results
+done
+for repeat in $(seq 1 7); do
+  echo "${units}" | while read bench impl; do
+    echo ${bench} ${impl} ${repeat}
   done
 done | sort -R | while read bench impl repeat; do
+  # policy-based Partition configurations: Storage x Layout x SubsetIndex bits
+  if [[ ${impl} == Partition/* ]]; then
+    results=${bench}.policies.results
+  else
+    results=${bench}.results
+  fi
   echo ${bench} ${impl} ${repeat}
-  ./benchmark ${bench} ${impl} >> ${bench}.results
+  ./benchmark --dims=${dims} ${bench} ${impl} >> ${results}
 done
-
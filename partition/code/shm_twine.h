@@ -0,0 +1,353 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <new>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "chunk_twine.h"
+
+/*
+ * ChunkTwine stored in a single shared memory region (memfd), so that one
+ * writer process and any number of reader processes share one copy. The
+ * region is filled from a ChunkTwine built in private memory; after that the
+ * writer applies Assign() to the region directly.
+ *
+ * The region is mapped at different addresses in different processes, so
+ * chunks are linked by their index in the chunk array instead of by pointer.
+ * The writer wraps every Assign() into a seqlock: the generation counter is
+ * odd while a change is in progress. Readers never block the writer; a reader
+ * which copies a subset while it changes detects that by the generation and
+ * retries. Every shared field is a relaxed atomic, which compiles to plain
+ * loads and stores on x86.
+ *
+ * Region layout: Header | ItemData[num_items] | SubsetData[num_subsets] |
+ * Chunk[num_chunks], each part aligned to a cache line.
+ */
+template<int kChunkCapacity>
+class ShmTwine {
+private:
+  struct Header {
+    std::atomic<uint64_t> generation; // odd while writer is changing the region
+    int num_items;
+    int num_subsets;
+    int num_chunks;
+    std::atomic<int> free; // index of the first free chunk
+  };
+
+  struct Chunk {
+    std::atomic<int> next;
+    std::atomic<int> prev;
+    std::array<std::atomic<int>, kChunkCapacity> items;
+    std::atomic<int> num_items;
+  };
+
+  struct ItemData {
+    std::atomic<int> chunk; // index into chunk array
+    std::atomic<int> chpos; // position inside Chunk.items
+    std::atomic<int> subset;
+  };
+
+  struct SubsetData {
+    std::atomic<int> back; // index into chunk array
+  };
+
+  static constexpr size_t kAlignment = 64;
+
+  static size_t AlignUp(size_t size) {
+    return (size + kAlignment - 1) / kAlignment * kAlignment;
+  }
+
+  static int Get(const std::atomic<int>& field) {
+    return field.load(std::memory_order_relaxed);
+  }
+
+  static void Set(std::atomic<int>& field, int value) {
+    field.store(value, std::memory_order_relaxed);
+  }
+
+public:
+  // writer: create region for num_items items and num_subsets subsets in a new memfd
+  ShmTwine(int num_items, int num_subsets) :
+      ShmTwine(ChunkTwine<kChunkCapacity>(num_items, num_subsets), num_items) {}
+
+  // reader: map region of a twine created by another process, e.g. inherited through fork()
+  explicit ShmTwine(int fd) :
+      fd_(::dup(fd))
+  {
+    if (fd_ == -1) {
+      throw std::system_error(errno, std::generic_category(), "dup");
+    }
+    struct stat st;
+    if (::fstat(fd_, &st) != 0) {
+      int err = errno;
+      ::close(fd_);
+      throw std::system_error(err, std::generic_category(), "fstat");
+    }
+    size_ = st.st_size;
+    Map(PROT_READ);
+    header_ = static_cast<Header*>(base_);
+    Locate();
+  }
+
+  ShmTwine(ShmTwine&& that) :
+      fd_(std::exchange(that.fd_, -1)),
+      size_(that.size_),
+      base_(std::exchange(that.base_, nullptr)),
+      header_(that.header_),
+      item_data_(that.item_data_),
+      subset_data_(that.subset_data_),
+      chunks_(that.chunks_) {}
+
+  ~ShmTwine() {
+    if (base_) {
+      ::munmap(base_, size_);
+    }
+    if (fd_ != -1) {
+      ::close(fd_);
+    }
+  }
+
+  ShmTwine(const ShmTwine&) = delete;
+  ShmTwine& operator=(const ShmTwine&) = delete;
+  ShmTwine& operator=(ShmTwine&&) = delete;
+
+  // writer: bulk load from subset_of[item] array, same layout as ChunkTwine::FromAssignment()
+  static ShmTwine FromAssignment(const int* subset_of, int num_items, int num_subsets) {
+    return ShmTwine(ChunkTwine<kChunkCapacity>::FromAssignment(subset_of, num_items, num_subsets), num_items);
+  }
+
+  // descriptor of the region, to be passed to reader processes
+  int fd() const { return fd_; }
+
+  size_t region_size() const { return size_; }
+
+  uint64_t generation() const {
+    return header_->generation.load(std::memory_order_acquire);
+  }
+
+  // single field, consistent without the seqlock
+  int SubsetOf(int item) const {
+    return Get(item_data_[item].subset);
+  }
+
+  /*
+   * Consistent copy of the items of subset. A copy taken while the writer was
+   * active is thrown away and retaken. Reading a half-updated chunk list may
+   * follow links into other lists, so the walk is bounded by the total number
+   * of chunks.
+   */
+  void SnapshotOf(int subset, std::vector<int>& items) const {
+    for (;;) {
+      uint64_t generation = header_->generation.load(std::memory_order_acquire);
+      if ((generation % 2 == 0) && CopyItems(subset, items)) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (header_->generation.load(std::memory_order_relaxed) == generation) {
+          return;
+        }
+      }
+      __builtin_ia32_pause();
+    }
+  }
+
+  // writer only
+  void Assign(int item, int subset) {
+    if (Get(item_data_[item].subset) == subset) {
+      return;
+    }
+    BeginWrite();
+
+    ItemData& id = item_data_[item];
+    int curr_subset = Get(id.subset);
+    if (curr_subset != -1) {
+      int back = Get(subset_data_[curr_subset].back);
+      Chunk& back_chunk = chunks_[back];
+      int num_items = Get(back_chunk.num_items) - 1;
+      Set(back_chunk.num_items, num_items);
+      int back_item = Get(back_chunk.items[num_items]);
+      if (num_items == 0) {
+        PopChunk(&subset_data_[curr_subset].back);
+        PushChunk(&header_->free, back);
+      }
+
+      if (item != back_item) {
+        // move back item to the position previously occupied by item
+        Set(chunks_[Get(id.chunk)].items[Get(id.chpos)], back_item);
+        Set(item_data_[back_item].chunk, Get(id.chunk));
+        Set(item_data_[back_item].chpos, Get(id.chpos));
+      }
+
+      Set(id.subset, -1);
+      Set(id.chunk, -1);
+      Set(id.chpos, -1);
+    }
+
+    if (subset != -1) {
+      int back = Get(subset_data_[subset].back);
+      if ((back == -1) || (Get(chunks_[back].num_items) == kChunkCapacity)) {
+        back = PopChunk(&header_->free);
+        Set(chunks_[back].num_items, 0);
+        PushChunk(&subset_data_[subset].back, back);
+      }
+      Chunk& chunk = chunks_[back];
+      int chpos = Get(chunk.num_items);
+      Set(chunk.items[chpos], item);
+      Set(chunk.num_items, chpos + 1);
+      Set(id.subset, subset);
+      Set(id.chunk, back);
+      Set(id.chpos, chpos);
+    }
+
+    EndWrite();
+  }
+
+private:
+  /*
+   * Writer: new memfd holding a copy of twine. Chunk i of the region is
+   * chunk_pool_[i] of twine, so pointers of twine turn into indices and the
+   * layout, e.g. the contiguous runs of FromAssignment(), is kept.
+   */
+  ShmTwine(const ChunkTwine<kChunkCapacity>& twine, int num_items) :
+      fd_(::memfd_create("shm_twine", MFD_CLOEXEC))
+  {
+    if (fd_ == -1) {
+      throw std::system_error(errno, std::generic_category(), "memfd_create");
+    }
+    int num_subsets = twine.num_subsets_;
+    int num_chunks = twine.num_chunks_;
+    size_ = RegionSize(num_items, num_subsets, num_chunks);
+    if (::ftruncate(fd_, size_) != 0) {
+      int err = errno;
+      ::close(fd_);
+      throw std::system_error(err, std::generic_category(), "ftruncate");
+    }
+    Map(PROT_READ | PROT_WRITE);
+
+    header_ = new (base_) Header();
+    header_->generation.store(0, std::memory_order_relaxed);
+    header_->num_items = num_items;
+    header_->num_subsets = num_subsets;
+    header_->num_chunks = num_chunks;
+    Locate();
+
+    auto index = [pool = twine.chunk_pool_.get()](const auto* chunk) {
+      return chunk ? int(chunk - pool) : -1;
+    };
+    for (int i = 0; i < num_items; i++) {
+      const auto& from = twine.item_data_[i];
+      ItemData* id = new (&item_data_[i]) ItemData();
+      Set(id->chunk, index(from.chunk));
+      Set(id->chpos, from.chpos);
+      Set(id->subset, from.subset);
+    }
+    for (int s = 0; s < num_subsets; s++) {
+      Set((new (&subset_data_[s]) SubsetData())->back, index(twine.subset_data_[s].back));
+    }
+    for (int i = 0; i < num_chunks; i++) {
+      const auto& from = twine.chunk_pool_[i];
+      Chunk* chunk = new (&chunks_[i]) Chunk();
+      Set(chunk->next, index(from.next));
+      Set(chunk->prev, index(from.prev));
+      Set(chunk->num_items, from.num_items);
+      for (int j = 0; j < from.num_items; j++) {
+        Set(chunk->items[j], from.items[j]);
+      }
+    }
+    Set(header_->free, index(twine.free_));
+  }
+
+  static size_t RegionSize(int num_items, int num_subsets, int num_chunks) {
+    return AlignUp(sizeof(Header)) +
+           AlignUp(sizeof(ItemData) * num_items) +
+           AlignUp(sizeof(SubsetData) * num_subsets) +
+           AlignUp(sizeof(Chunk) * num_chunks);
+  }
+
+  void Map(int prot) {
+    void* base = ::mmap(nullptr, size_, prot, MAP_SHARED, fd_, 0);
+    if (base == MAP_FAILED) {
+      int err = errno;
+      ::close(fd_);
+      throw std::system_error(err, std::generic_category(), "mmap");
+    }
+    base_ = base;
+  }
+
+  // compute addresses of region parts from the header
+  void Locate() {
+    char* p = static_cast<char*>(base_) + AlignUp(sizeof(Header));
+    item_data_ = reinterpret_cast<ItemData*>(p);
+    p += AlignUp(sizeof(ItemData) * header_->num_items);
+    subset_data_ = reinterpret_cast<SubsetData*>(p);
+    p += AlignUp(sizeof(SubsetData) * header_->num_subsets);
+    chunks_ = reinterpret_cast<Chunk*>(p);
+  }
+
+  void BeginWrite() {
+    uint64_t generation = header_->generation.load(std::memory_order_relaxed);
+    header_->generation.store(generation + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  void EndWrite() {
+    uint64_t generation = header_->generation.load(std::memory_order_relaxed);
+    header_->generation.store(generation + 1, std::memory_order_release);
+  }
+
+  // false if the walk ran into a state that only a concurrent write can produce
+  bool CopyItems(int subset, std::vector<int>& items) const {
+    items.clear();
+    int num_chunks = header_->num_chunks;
+    int hops = 0;
+    for (int c = Get(subset_data_[subset].back); c != -1; c = Get(chunks_[c].next)) {
+      if ((c < -1) || (c >= num_chunks) || (++hops > num_chunks)) {
+        return false;
+      }
+      int num_items = Get(chunks_[c].num_items);
+      if ((num_items < 0) || (num_items > kChunkCapacity)) {
+        return false;
+      }
+      for (int i = 0; i < num_items; i++) {
+        items.push_back(Get(chunks_[c].items[i]));
+      }
+    }
+    return true;
+  }
+
+  int PopChunk(std::atomic<int>* back) {
+    int chunk = Get(*back);
+    int next = Get(chunks_[chunk].next);
+    Set(*back, next);
+    if (next != -1) {
+      Set(chunks_[next].prev, -1);
+    }
+    Set(chunks_[chunk].next, -1);
+    return chunk;
+  }
+
+  void PushChunk(std::atomic<int>* back, int chunk) {
+    int next = Get(*back);
+    Set(chunks_[chunk].next, next);
+    Set(chunks_[chunk].prev, -1);
+    if (next != -1) {
+      Set(chunks_[next].prev, chunk);
+    }
+    Set(*back, chunk);
+  }
+
+  int fd_;
+  size_t size_;
+  void* base_;
+  Header* header_;
+  ItemData* item_data_;
+  SubsetData* subset_data_;
+  Chunk* chunks_;
+};
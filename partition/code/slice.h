@@ -0,0 +1,19 @@
+#pragma once
+
+/*
+ * Part of a subset view delimited by a pair of view iterators. Returned by
+ * SplitViewOf(): slices of one subset are disjoint and together cover it.
+ */
+template<typename Iterator>
+class Slice {
+public:
+  Slice(Iterator begin, Iterator end) :
+      begin_(begin), end_(end) {}
+
+  Iterator begin() const { return begin_; }
+  Iterator end() const { return end_; }
+
+private:
+  Iterator begin_;
+  Iterator end_;
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+/*
+ * Log of moves for trial moves. While a savepoint is open, the container
+ * Push()es one record per move, holding whatever it needs to undo the move,
+ * e.g. the slot the item occupied before; with no open savepoint nothing is
+ * logged. Rollback() hands the records made since the savepoint to undo(),
+ * newest first, with logging switched off so that the undo itself is not
+ * recorded. Since moves are undone strictly in reverse order, undo() sees
+ * the container exactly as the move left it.
+ */
+template<typename Move>
+class MoveLog {
+public:
+  static_assert(std::is_trivially_copyable<Move>::value, "moves must be trivially copyable");
+
+  MoveLog() : size_(0), capacity_(0), depth_(0) {}
+
+  // true while a savepoint is open
+  bool logging() const {
+    return depth_ > 0;
+  }
+
+  void Push(const Move& move) {
+    if (size_ == capacity_) {
+      Grow();
+    }
+    moves_[size_++] = move;
+  }
+
+  // savepoints nest; each must be closed by either Rollback() or Release()
+  int Savepoint() {
+    depth_++;
+    return size_;
+  }
+
+  template<typename Undo>
+  void Rollback(int savepoint, Undo undo) {
+    size_t depth = depth_;
+    depth_ = 0;
+    while (size_ > size_t(savepoint)) {
+      undo(moves_[--size_]);
+    }
+    depth_ = depth;
+    Close();
+  }
+
+  // keep moves made since savepoint
+  void Release(int /*savepoint*/) {
+    Close();
+  }
+
+private:
+  void Close() {
+    depth_--;
+    if (depth_ == 0) {
+      size_ = 0;
+    }
+  }
+
+  // plain array rather than std::vector: Push() is on the hot path of trial moves
+  void __attribute__((noinline)) Grow() {
+    size_t capacity = std::max<size_t>(2 * capacity_, 256);
+    std::unique_ptr<Move[]> moves(new Move[capacity]);
+    std::copy(moves_.get(), moves_.get() + size_, moves.get());
+    moves_ = std::move(moves);
+    capacity_ = capacity;
+  }
+
+  std::unique_ptr<Move[]> moves_;
+  size_t size_;
+  size_t capacity_;
+  size_t depth_; // not int: stores to int fields of the container must not force its reload
+};
@@ -2,14 +2,76 @@
 set -e
 set -u
 
-algos="Naive Reverse Blocks BlocksPrf Vec32 Vec64 Vec256 Vec256Buf"
-sizes="320 576 704 1088 1472 2112 2880 4160 5824 8256 11584 16448 23232 30784 46400 65600 77888 92736 111808"
+algos="Naive Reverse Blocks BlocksPrf Vec32 Vec64 Vec256 Vec256Buf Vec256Vbmi Vec512 Vec512Buf Recursive Tuned"
+sizes="320 576 704 1000 1088 1472 2112 2880 4096 4099 4160 5824 8192 8256 11584 16384 16448 23232 30784 46400 65600 77888 92736 111808"
+# tall-skinny tables, <rows>x<cols>
+shapes="1048576x64 1000000x100 1048576x256 1000000x300 16777216x64 64x1048576"
+
+# autotuning first: wisdom for every size, used by Tuned, see $TRANSPOSE_WISDOM
+for size in $sizes $shapes; do
+  echo "tune $size" >&2
+  ./transpose tune $size $((1024*1024*1024))
+done > tune.log
 
 for algo in $algos; do
-  for size in $sizes; do
+  for size in $sizes $shapes; do
     echo "$algo $size" >&2
     ./transpose $size $algo $((8*1024*1024*1024)) 0 1
   done > results/${algo}.result
 done
 
 
+
+# in place, square matrices only
+for size in $sizes; do
+  echo "InPlace $size" >&2
+  ./transpose $size InPlace $((8*1024*1024*1024)) 0 1
+done > results/InPlace.result
+
+
+# rows padded against cache set aliasing, results/<algo>.padded.result
+padded_algos="Blocks Vec256 Vec256Buf Vec512 Vec512Buf Recursive InPlace"
+
+for algo in $padded_algos; do
+  for size in $sizes; do
+    echo "$algo:padded $size" >&2
+    ./transpose $size $algo:padded $((8*1024*1024*1024)) 0 1
+  done > results/${algo}.padded.result
+done
+
+
+# out of core: matrices in files, 1 GiB memory budget, O_DIRECT
+dir=${TRANSPOSE_DIR:-/var/tmp}
+file_shapes="32768x32768 65536x65536 1048576x4096"
+
+for shape in $file_shapes; do
+  echo "File $shape" >&2
+  ./transpose file $shape $dir/transpose.src $dir/transpose.dst $((1024*1024*1024)) 1 1
+  rm -f $dir/transpose.src $dir/transpose.dst
+done > results/File.result
+
+
+# 2-, 4- and 8-byte elements, results/<algo>.<type>.result
+wide_algos="Naive Reverse Blocks Vec256"
+types="u16 u32 u64"
+
+for type in $types; do
+  for algo in $wide_algos; do
+    for size in $sizes; do
+      echo "$algo:$type $size" >&2
+      ./transpose $size $algo:$type $((8*1024*1024*1024)) 0 1
+    done > results/${algo}.${type}.result
+  done
+done
+
+
+# multi-threaded variants: one line per thread count
+parallel_algos="Vec256Static Vec256Steal Vec256BufStatic Vec256BufSteal"
+threads="1,2,4,8,16,32"
+
+for algo in $parallel_algos; do
+  for size in $sizes $shapes; do
+    echo "$algo $size" >&2
+    ./transpose $size $algo $((8*1024*1024*1024)) 0 1 $threads
+  done > results/${algo}.result
+done
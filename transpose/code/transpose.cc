@@ -12,6 +12,22 @@
 #include <unordered_map>
 #include <memory>
 #include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <fstream>
+#include <numeric>
+#include <future>
+#include <cmath>
+#include <sstream>
+#include <limits>
+
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 
 
 /************ Utility *******************/
@@ -36,77 +52,254 @@ inline uint64_t xorshift64(){
 }
 
 
+/************ CPU dispatch *******************/
+
+/**
+ * Instruction set used by vector kernels. The binary is built for baseline
+ * x86-64 (SSE2); AVX2 and AVX-512 kernels are compiled under
+ * #pragma GCC target and are called only if CPUID reports the extension, so
+ * one binary runs on any x86-64 host. Each algorithm keeps its own kernel
+ * and steps down only when the CPU lacks it.
+ * Environment variable TRANSPOSE_ISA=scalar|sse|avx2|avx512 lowers the level,
+ * e.g. to compare kernels on the same machine.
+ */
+enum class Isa { Scalar, Sse, Avx2, Avx512 };
+
+const char* isa_name(Isa isa) {
+  switch (isa) {
+    case Isa::Scalar: return "scalar";
+    case Isa::Sse:    return "sse";
+    case Isa::Avx2:   return "avx2";
+    default:          return "avx512";
+  }
+}
+
+/* inverse of isa_name() */
+Isa parse_isa(const std::string& name) {
+  Isa isa = Isa::Scalar;
+  while (isa != Isa::Avx512 && name != isa_name(isa)) {
+    isa = Isa(int(isa) + 1);
+  }
+  ensure(name == isa_name(isa));
+  return isa;
+}
+
+Isa detect_isa() {
+  __builtin_cpu_init();
+  Isa isa = Isa::Sse;
+  if (__builtin_cpu_supports("avx2")) {
+    isa = Isa::Avx2;
+    if (__builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512vbmi")) {
+      isa = Isa::Avx512;
+    }
+  }
+
+  const char* env = getenv("TRANSPOSE_ISA");
+  if (env) {
+    isa = std::min(isa, parse_isa(env));
+  }
+  return isa;
+}
+
+static const Isa ISA = detect_isa();
+
+
 /************ Mat *******************/
 
-class Mat {
+/**
+ * rows x cols matrix of T (uint8_t, uint16_t, uint32_t or uint64_t; float
+ * and double are transposed as bit patterns of the same size), row r starts
+ * at data() + r*ld(), ld() counted in elements. A view does not own its data,
+ * so it can describe a sub-matrix of an external buffer (ld > cols) with no
+ * copy. Transposes read a rows x cols src view and write a cols x rows dst
+ * view.
+ */
+template<typename T>
+class MatViewT {
 public:
-  Mat(int64_t n) :
-    _n(n),
-    _data(static_cast<uint8_t*>(std::aligned_alloc(64, n*n)))
+  MatViewT(T* data, int64_t rows, int64_t cols, int64_t ld) :
+    _rows(rows),
+    _cols(cols),
+    _ld(ld),
+    _data(data)
   {
-    ensure(_data);
+    ensure(rows >= 0 && cols >= 0 && ld >= cols);
+  }
+
+  int64_t rows() const { return _rows; }
+  int64_t cols() const { return _cols; }
+  int64_t ld() const { return _ld; }
+
+  const T* data() const { return _data; }
+  T* data() { return _data; }
+
+  T at(int64_t row, int64_t col) const { return _data[row*_ld+col]; }
+  T& at(int64_t row, int64_t col) { return _data[row*_ld+col]; }
+
+  /* rows x cols sub-matrix with top left corner at (row, col) */
+  MatViewT sub(int64_t row, int64_t col, int64_t rows, int64_t cols) const {
+    ensure(row >= 0 && col >= 0 && row + rows <= _rows && col + cols <= _cols);
+    return MatViewT(_data + row*_ld + col, rows, cols, _ld);
   }
 
-  ~Mat() {
-    std::free(_data);
+protected:
+  int64_t _rows;
+  int64_t _cols;
+  int64_t _ld;
+  T* _data;
+};
+
+/* Data and unified caches of cpu0 as listed in /sys/devices/system/cpu/cpu0/cache */
+struct CacheGeometry {
+  int level;
+  int64_t line_size;
+  int64_t nr_sets;
+  int64_t ways;
+};
+
+const std::vector<CacheGeometry>& cache_geometry() {
+  static const std::vector<CacheGeometry> caches = [] {
+    std::vector<CacheGeometry> caches;
+    for (int index = 0; ; index++) {
+      std::string dir = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(index) + "/";
+      std::ifstream type_in(dir + "type");
+      if (!type_in) {
+        break;
+      }
+      std::string type;
+      type_in >> type;
+      CacheGeometry cache = {};
+      std::ifstream(dir + "level") >> cache.level;
+      std::ifstream(dir + "coherency_line_size") >> cache.line_size;
+      std::ifstream(dir + "number_of_sets") >> cache.nr_sets;
+      std::ifstream(dir + "ways_of_associativity") >> cache.ways;
+      if (type != "Instruction" && cache.line_size > 0 && cache.nr_sets > 0) {
+        caches.push_back(cache);
+      }
+    }
+    if (caches.empty()) {
+      // no cache info in sysfs: 48 KiB 12-way L1d with 64-byte lines
+      caches.push_back({1, 64, 64, 12});
+    }
+    return caches;
+  }();
+  return caches;
+}
+
+/**
+ * Leading dimension in elements for rows of cols elements of T, padded so
+ * that 64 consecutive rows, a column of blocks, fall into as many distinct
+ * sets of every cache as possible: with a stride of L lines they occupy
+ * min(64, nr_sets/gcd(nr_sets, L)) sets. Without padding a row size that is
+ * a multiple of a large power of two maps a whole column of a block onto a
+ * few sets, see cache_set_load.py. Rows stay 64-byte aligned. For physically
+ * indexed caches beyond L1 only the offset inside a page is controlled.
+ */
+template<typename T>
+int64_t padded_ld(int64_t cols) {
+  const int64_t nr_rows = 64;
+  int64_t line_size = 64;
+  for (const CacheGeometry& cache : cache_geometry()) {
+    line_size = std::max(line_size, cache.line_size);
   }
+  int64_t bytes = std::max<int64_t>((cols*sizeof(T) + line_size - 1)/line_size*line_size, line_size);
+  auto spread = [&](int64_t bytes) {
+    for (const CacheGeometry& cache : cache_geometry()) {
+      int64_t lines = bytes/cache.line_size;
+      if (cache.nr_sets/std::gcd(cache.nr_sets, lines) < std::min(nr_rows, cache.nr_sets)) {
+        return false;
+      }
+    }
+    return true;
+  };
+  while (!spread(bytes)) {
+    bytes += line_size;
+  }
+  return bytes/sizeof(T);
+}
 
-  int64_t n() const { return _n; }
+/* Leading dimension of MatT: equal to cols, or padded_ld() */
+enum class Padding { None, Cache };
 
-  const uint8_t* data() const { return _data; }
-  uint8_t* data() { return _data; }
+/* Matrix owning its storage, 64-byte aligned, rows are contiguous unless padded */
+template<typename T>
+class MatT : public MatViewT<T> {
+public:
+  MatT(int64_t rows, int64_t cols, int64_t ld) :
+    MatViewT<T>(allocate(rows*ld), rows, cols, ld)
+  {}
+
+  MatT(int64_t rows, int64_t cols, Padding padding = Padding::None) :
+    MatT(rows, cols, (padding == Padding::Cache) ? padded_ld<T>(cols) : cols)
+  {}
 
-  uint8_t at(int64_t row, int64_t col) const { return _data[row*_n+col]; }
-  uint8_t& at(int64_t row, int64_t col) { return _data[row*_n+col]; }
+  explicit MatT(int64_t n) : MatT(n, n) {}
+
+  ~MatT() {
+    std::free(this->_data);
+  }
 
-  Mat(const Mat&) = delete;
-  Mat& operator=(const Mat&) = delete;
+  MatT(const MatT&) = delete;
+  MatT& operator=(const MatT&) = delete;
 
 private:
-  int64_t _n;
-  uint8_t* _data;
+  static T* allocate(int64_t size) {
+    int64_t bytes = size*sizeof(T);
+    T* data = static_cast<T*>(std::aligned_alloc(64, std::max<int64_t>((bytes + 63) / 64 * 64, 64)));
+    ensure(data);
+    return data;
+  }
 };
 
+typedef MatViewT<uint8_t> MatView;
+typedef MatT<uint8_t> Mat;
+
 
 
-void fill_random(Mat* mat) {
+/* padding of rows included */
+template<typename T>
+void fill_random(MatT<T>* mat) {
+  const int64_t size = mat->rows()*mat->ld()*sizeof(T);
+  uint8_t* data = reinterpret_cast<uint8_t*>(mat->data());
   int64_t off = 0;
-  while (off+8 < mat->n()*mat->n()) {
-    *(uint64_t*)(mat->data() + off) = xorshift64();
-    *(uint64_t*)(mat->data() + off) = xorshift64();
+  while (off+8 < size) {
+    *(uint64_t*)(data + off) = xorshift64();
+    *(uint64_t*)(data + off) = xorshift64();
     off += 4;
   }
-  while (off < mat->n()*mat->n()) {
-    mat->data()[off] = xorshift64();
-    mat->data()[off] = xorshift64();
+  while (off < size) {
+    data[off] = xorshift64();
+    data[off] = xorshift64();
     off += 1;
   }
 }
  
-std::ostream& operator<<(std::ostream& out, const Mat& mat) {
+template<typename T>
+std::ostream& operator<<(std::ostream& out, const MatViewT<T>& mat) {
   std::ostream tmp(out.rdbuf());
   tmp << std::hex;
   tmp << std::uppercase;
 
-  for (int i = 0; i < mat.n(); i++) {
+  for (int i = 0; i < mat.rows(); i++) {
     if (i > 0) {
       tmp << std::endl;
     }
-    for (int j = 0; j < mat.n(); j++) {
+    for (int j = 0; j < mat.cols(); j++) {
       if (j > 0) {
         tmp << ' ';
       }
-      tmp << std::setw(2) << std::setfill('0') << (int)mat.at(i, j);
+      tmp << std::setw(2*sizeof(T)) << std::setfill('0') << (uint64_t)mat.at(i, j);
     }
   }
   
   return out;
 }
 
-void check_transpose(const Mat& mat1, const Mat& mat2) {
-  ensure(mat1.n() == mat2.n());
-  for (int64_t i = 0; i < mat1.n(); i++) {
-    for (int64_t j = 0; j < mat1.n(); j++) {
+template<typename T>
+void check_transpose(const MatViewT<T>& mat1, const MatViewT<T>& mat2) {
+  ensure(mat1.rows() == mat2.cols() && mat1.cols() == mat2.rows());
+  for (int64_t i = 0; i < mat1.rows(); i++) {
+    for (int64_t j = 0; j < mat1.cols(); j++) {
       ensure(mat1.at(i, j) == mat2.at(j, i));
     }
   }
@@ -115,35 +308,40 @@ void check_transpose(const Mat& mat1, const Mat& mat2) {
 
 /******************* Naive *************************/
 
-void transpose_Naive(const Mat& src, Mat* dst) {
-  const int64_t n = src.n();
-  for (int64_t r = 0; r < n; r++) {
-    for (int64_t c = 0; c < n; c++) {
-      dst->data()[n * c + r] = src.data()[n * r + c];
+template<typename T>
+void transpose_Naive(const MatViewT<T>& src, MatViewT<T>* dst) {
+  const int64_t rows = src.rows(), cols = src.cols();
+  const int64_t src_ld = src.ld(), dst_ld = dst->ld();
+  const T* src_data = src.data();
+        T* dst_data = dst->data();
+  for (int64_t r = 0; r < rows; r++) {
+    for (int64_t c = 0; c < cols; c++) {
+      dst_data[dst_ld * c + r] = src_data[src_ld * r + c];
     }
   }
 }
 
-void transpose_NaiveSmall(const Mat& src, Mat* dst) {
-  const int64_t n = src.n();
-  for (int64_t r = 0; r < n; r++) {
-    const uint8_t* src_ptr = src.data()  + r * n; // beginning of r-th row
-    const uint8_t* src_ptr_end = src_ptr + n;
-          uint8_t* dst_ptr0 = dst->data() + r + n*0; // beginning of r-th column
-          uint8_t* dst_ptr1 = dst->data() + r + n*1;
+void transpose_NaiveSmall(const MatView& src, MatView* dst) {
+  const int64_t rows = src.rows(), cols = src.cols();
+  const int64_t src_ld = src.ld(), dst_ld = dst->ld();
+  for (int64_t r = 0; r < rows; r++) {
+    const uint8_t* src_ptr = src.data()  + r * src_ld; // beginning of r-th row
+    const uint8_t* src_ptr_end = src_ptr + cols;
+          uint8_t* dst_ptr0 = dst->data() + r + dst_ld*0; // beginning of r-th column
+          uint8_t* dst_ptr1 = dst->data() + r + dst_ld*1;
     while (src_ptr + 2 <= src_ptr_end) {
       *dst_ptr0 = *(src_ptr + 0);
       *dst_ptr1 = *(src_ptr + 1);
 
-      dst_ptr0 += 2*n;
-      dst_ptr1 += 2*n;
+      dst_ptr0 += 2*dst_ld;
+      dst_ptr1 += 2*dst_ld;
 
       src_ptr += 2;
     }
     while (src_ptr < src_ptr_end) {
       *dst_ptr0 = *src_ptr;
       src_ptr += 1;
-      dst_ptr0 += n;
+      dst_ptr0 += dst_ld;
     }
   }
 }
@@ -151,11 +349,15 @@ void transpose_NaiveSmall(const Mat& src, Mat* dst) {
 
 /******************* Reverse *************************/
 
-void transpose_Reverse(const Mat& src, Mat* dst) {
-  const int64_t n = src.n();
-  for (int64_t r = 0; r < n; r++) {
-    for (int64_t c = 0; c < n; c++) {
-      dst->data()[n * r + c] = src.data()[n * c + r];
+template<typename T>
+void transpose_Reverse(const MatViewT<T>& src, MatViewT<T>* dst) {
+  const int64_t rows = src.rows(), cols = src.cols();
+  const int64_t src_ld = src.ld(), dst_ld = dst->ld();
+  const T* src_data = src.data();
+        T* dst_data = dst->data();
+  for (int64_t r = 0; r < cols; r++) {
+    for (int64_t c = 0; c < rows; c++) {
+      dst_data[dst_ld * r + c] = src_data[src_ld * c + r];
     }
   }
 }
@@ -163,65 +365,81 @@ void transpose_Reverse(const Mat& src, Mat* dst) {
 
 /*********************** Blocks ****************************/
 
-void transpose_Blocks(const Mat& src, Mat* dst) {
-  const int64_t n = src.n();
-  const int64_t bsize = 64;
-  for (int64_t rb = 0; rb < src.n()/bsize; rb++) {
-    for (int64_t cb = 0; cb < src.n()/bsize; cb++) {
-      const uint8_t* src_origin = src.data()  + (rb * n + cb) * bsize;
-            uint8_t* dst_origin = dst->data() + (cb * n + rb) * bsize;
+/* Blocks are one cache line wide: 64x64 bytes, 32x32 uint16_t, etc. */
+template<typename T>
+constexpr int64_t block_size() {
+  return 64/sizeof(T);
+}
+
+template<typename T>
+void transpose_Border(const MatViewT<T>& src, MatViewT<T>* dst);
+
+template<typename T>
+void transpose_Blocks(const MatViewT<T>& src, MatViewT<T>* dst) {
+  const int64_t src_ld = src.ld(), dst_ld = dst->ld();
+  const int64_t bsize = block_size<T>();
+  const int64_t nrb = src.rows()/bsize, ncb = src.cols()/bsize;
+  for (int64_t rb = 0; rb < nrb; rb++) {
+    for (int64_t cb = 0; cb < ncb; cb++) {
+      const T* src_origin = src.data()  + (rb * src_ld + cb) * bsize;
+            T* dst_origin = dst->data() + (cb * dst_ld + rb) * bsize;
       for (int64_t r = 0; r < bsize; r++) {
         for (int64_t c = 0; c < bsize; c++) {
-          dst_origin[r * n + c] = src_origin[c * n + r];
+          dst_origin[r * dst_ld + c] = src_origin[c * src_ld + r];
         }
       }
     }
   }
+  transpose_Border(src, dst);
 }
 
 /*********************** BlocksPrf ****************************/
 
-/* Compute origin of the 64-block next to (rb, cb) in row-major order */
-inline const uint8_t* next_block(const Mat& src, int64_t rb, int64_t cb) {
+/* Compute origin of the block next to (rb, cb) in row-major order */
+template<typename T>
+inline const T* next_block(const MatViewT<T>& src, int64_t rb, int64_t cb) {
+  const int64_t bsize = block_size<T>();
   int64_t cb1 = cb + 1;
   int64_t rb1 = rb;
-  if (cb1 == src.n()/64) {
+  if (cb1 == src.cols()/bsize) {
     rb1 += 1;
     cb1 = 0;
   }
-  return src.data() + (rb1*src.n() + cb1) * 64;
+  return src.data() + (rb1*src.ld() + cb1) * bsize;
 }
 
-void transpose_BlocksPrf(const Mat& src, Mat* dst) {
-  const int64_t n = src.n();
+void transpose_BlocksPrf(const MatView& src, MatView* dst) {
+  const int64_t src_ld = src.ld(), dst_ld = dst->ld();
   const int64_t bsize = 64;
-  for (int64_t rb = 0; rb < src.n()/bsize; rb++) {
-    for (int64_t cb = 0; cb < src.n()/bsize; cb++) {
-      const uint8_t* src_origin = src.data() + (rb*n+cb)*bsize;
-            uint8_t* dst_origin = dst->data() + (cb*n+rb)*bsize;
+  const int64_t nrb = src.rows()/bsize, ncb = src.cols()/bsize;
+  for (int64_t rb = 0; rb < nrb; rb++) {
+    for (int64_t cb = 0; cb < ncb; cb++) {
+      const uint8_t* src_origin = src.data() + (rb*src_ld+cb)*bsize;
+            uint8_t* dst_origin = dst->data() + (cb*dst_ld+rb)*bsize;
       const uint8_t* prf_origin = next_block(src, rb, cb);
       for (int64_t r = 0; r < bsize; r++) {
-        _mm_prefetch(prf_origin + r*n, _MM_HINT_NTA);
+        _mm_prefetch(prf_origin + r*src_ld, _MM_HINT_NTA);
         for (int64_t c = 0; c < bsize; c++) {
-          dst_origin[r * n + c] = src_origin[c * n + r];
+          dst_origin[r * dst_ld + c] = src_origin[c * src_ld + r];
         }
       }
     }
   }
+  transpose_Border(src, dst);
 }
 
 /*********************** Vec32/Vec64 ***********************/
 
 template<typename W> /* W is either u32 or u64 and defines word size */
-void transpose_Vec_kernel(const uint8_t* src, uint8_t* dst, int64_t stride);
+void transpose_Vec_kernel(const uint8_t* src, uint8_t* dst, int64_t src_stride, int64_t dst_stride);
 
 template<>
-void transpose_Vec_kernel<uint32_t>(const uint8_t* src, uint8_t* dst, int64_t stride) {
+void transpose_Vec_kernel<uint32_t>(const uint8_t* src, uint8_t* dst, int64_t src_stride, int64_t dst_stride) {
   // load rows of src matrix
-  uint32_t a0 = *((uint32_t*)(src+0*stride));
-  uint32_t a1 = *((uint32_t*)(src+1*stride));
-  uint32_t a2 = *((uint32_t*)(src+2*stride));
-  uint32_t a3 = *((uint32_t*)(src+3*stride));
+  uint32_t a0 = *((uint32_t*)(src+0*src_stride));
+  uint32_t a1 = *((uint32_t*)(src+1*src_stride));
+  uint32_t a2 = *((uint32_t*)(src+2*src_stride));
+  uint32_t a3 = *((uint32_t*)(src+3*src_stride));
 
   // 2x2 block matrices
   uint32_t b0 = (a0 & 0x00ff00ffU) | ((a1 << 8) & 0xff00ff00U);
@@ -236,24 +454,24 @@ void transpose_Vec_kernel<uint32_t>(const uint8_t* src, uint8_t* dst, int64_t st
   uint32_t c3 = (b3 & 0xffff0000U) | ((b1 >> 16) & 0x0000ffffU);
 
   // write to dst matrix
-  *(uint32_t*)(dst + 0*stride) = c0;
-  *(uint32_t*)(dst + 1*stride) = c1;
-  *(uint32_t*)(dst + 2*stride) = c2;
-  *(uint32_t*)(dst + 3*stride) = c3;
+  *(uint32_t*)(dst + 0*dst_stride) = c0;
+  *(uint32_t*)(dst + 1*dst_stride) = c1;
+  *(uint32_t*)(dst + 2*dst_stride) = c2;
+  *(uint32_t*)(dst + 3*dst_stride) = c3;
 }
 
 
 template<>
-void transpose_Vec_kernel<uint64_t>(const uint8_t* src, uint8_t* dst, int64_t stride) {
+void transpose_Vec_kernel<uint64_t>(const uint8_t* src, uint8_t* dst, int64_t src_stride, int64_t dst_stride) {
   // load rows of src matrix
-  uint64_t a0 = *((uint64_t*)(src+0*stride));
-  uint64_t a1 = *((uint64_t*)(src+1*stride));
-  uint64_t a2 = *((uint64_t*)(src+2*stride));
-  uint64_t a3 = *((uint64_t*)(src+3*stride));
-  uint64_t a4 = *((uint64_t*)(src+4*stride));
-  uint64_t a5 = *((uint64_t*)(src+5*stride));
-  uint64_t a6 = *((uint64_t*)(src+6*stride));
-  uint64_t a7 = *((uint64_t*)(src+7*stride));
+  uint64_t a0 = *((uint64_t*)(src+0*src_stride));
+  uint64_t a1 = *((uint64_t*)(src+1*src_stride));
+  uint64_t a2 = *((uint64_t*)(src+2*src_stride));
+  uint64_t a3 = *((uint64_t*)(src+3*src_stride));
+  uint64_t a4 = *((uint64_t*)(src+4*src_stride));
+  uint64_t a5 = *((uint64_t*)(src+5*src_stride));
+  uint64_t a6 = *((uint64_t*)(src+6*src_stride));
+  uint64_t a7 = *((uint64_t*)(src+7*src_stride));
 
   // 2x2 block matrices
   uint64_t b0 = (a0 & 0x00ff00ff00ff00ffULL) | ((a1 << 8) & 0xff00ff00ff00ff00ULL);
@@ -286,63 +504,187 @@ void transpose_Vec_kernel<uint64_t>(const uint8_t* src, uint8_t* dst, int64_t st
   uint64_t d7 = (c7 & 0xffffffff00000000ULL) | ((c3 >> 32) & 0x00000000ffffffffULL);
 
   // write to dst matrix
-  *(uint64_t*)(dst + 0*stride) = d0;
-  *(uint64_t*)(dst + 1*stride) = d1;
-  *(uint64_t*)(dst + 2*stride) = d2;
-  *(uint64_t*)(dst + 3*stride) = d3;
-  *(uint64_t*)(dst + 4*stride) = d4;
-  *(uint64_t*)(dst + 5*stride) = d5;
-  *(uint64_t*)(dst + 6*stride) = d6;
-  *(uint64_t*)(dst + 7*stride) = d7;
+  *(uint64_t*)(dst + 0*dst_stride) = d0;
+  *(uint64_t*)(dst + 1*dst_stride) = d1;
+  *(uint64_t*)(dst + 2*dst_stride) = d2;
+  *(uint64_t*)(dst + 3*dst_stride) = d3;
+  *(uint64_t*)(dst + 4*dst_stride) = d4;
+  *(uint64_t*)(dst + 5*dst_stride) = d5;
+  *(uint64_t*)(dst + 6*dst_stride) = d6;
+  *(uint64_t*)(dst + 7*dst_stride) = d7;
 }
 
 template<typename W>
-void transpose_Vec(const Mat& src, Mat* dst) {
-  const int64_t n = src.n();
+void transpose_Vec(const MatView& src, MatView* dst) {
+  const int64_t src_ld = src.ld(), dst_ld = dst->ld();
   const int64_t bsize = 64;
+  const int64_t nrb = src.rows()/bsize, ncb = src.cols()/bsize;
   
   // iterate over 64x64 block matrices
-  for (int64_t rb = 0; rb < n/bsize; rb++) {
-    for (int64_t cb = 0; cb < n/bsize; cb++) {
-      const uint8_t* srcb_origin = src.data()  + (rb*n+cb)*bsize;
-            uint8_t* dstb_origin = dst->data() + (cb*n+rb)*bsize;
+  for (int64_t rb = 0; rb < nrb; rb++) {
+    for (int64_t cb = 0; cb < ncb; cb++) {
+      const uint8_t* srcb_origin = src.data()  + (rb*src_ld+cb)*bsize;
+            uint8_t* dstb_origin = dst->data() + (cb*dst_ld+rb)*bsize;
       const uint8_t* prfb_origin = next_block(src, rb, cb);
 
       // iterate over sizeof(W)xsizeof(W) block matrices inside 64x64 block
       for (size_t rw = 0; rw < 64/sizeof(W); rw++) {
         // preload sizeof(W) rows of the next 64x64 block
         for (size_t i = rw*sizeof(W); i < (rw+1)*sizeof(W); i++) {
-          _mm_prefetch(prfb_origin + i*n, _MM_HINT_NTA);
+          _mm_prefetch(prfb_origin + i*src_ld, _MM_HINT_NTA);
         }
         for (size_t cw = 0; cw < 64/sizeof(W); cw++) {
-          const uint8_t* srcw_origin = srcb_origin + (cw*n + rw)*sizeof(W);
-                uint8_t* dstw_origin = dstb_origin + (rw*n + cw)*sizeof(W);
+          const uint8_t* srcw_origin = srcb_origin + cw*sizeof(W)*src_ld + rw*sizeof(W);
+                uint8_t* dstw_origin = dstb_origin + rw*sizeof(W)*dst_ld + cw*sizeof(W);
           // use vector kernel to transpose sizeof(W)xsizeof(W) matrix
-          transpose_Vec_kernel<W>(srcw_origin, dstw_origin, n);
+          transpose_Vec_kernel<W>(srcw_origin, dstw_origin, src_ld, dst_ld);
         }
       }
     }
   }
+  transpose_Border(src, dst);
+}
+
+/*********************** Sse ****************************/
+
+/* _mm_unpacklo/hi for elements of given width in bytes */
+inline __m128i unpack_lo(__m128i a, __m128i b, int width) {
+  switch (width) {
+    case 1:  return _mm_unpacklo_epi8(a, b);
+    case 2:  return _mm_unpacklo_epi16(a, b);
+    case 4:  return _mm_unpacklo_epi32(a, b);
+    default: return _mm_unpacklo_epi64(a, b);
+  }
+}
+
+inline __m128i unpack_hi(__m128i a, __m128i b, int width) {
+  switch (width) {
+    case 1:  return _mm_unpackhi_epi8(a, b);
+    case 2:  return _mm_unpackhi_epi16(a, b);
+    case 4:  return _mm_unpackhi_epi32(a, b);
+    default: return _mm_unpackhi_epi64(a, b);
+  }
+}
+
+/* x with its low nr_bits bits in reverse order */
+constexpr int reverse_low_bits(int x, int nr_bits) {
+  int res = x & ~((1 << nr_bits) - 1);
+  for (int i = 0; i < nr_bits; i++) {
+    res |= ((x >> i) & 1) << (nr_bits - 1 - i);
+  }
+  return res;
+}
+
+/**
+ * Transpose KxK tile of T, K = 16/sizeof(T), one row per SSE2 register:
+ * 16x16 bytes, 8x8 uint16_t, 4x4 uint32_t or 2x2 uint64_t. Every round
+ * interleaves rows 2p and 2p+1 at twice the element width of the previous
+ * round, low halves go to row p and high halves to row p+K/2. After log2(K)
+ * rounds register i holds column reverse_low_bits(i, log2(K)).
+ */
+template<typename T>
+void transpose_Sse_kernel(const T* src, T* dst, int64_t src_stride, int64_t dst_stride) {
+  constexpr int K = 16/sizeof(T);
+  constexpr int nr_rounds = __builtin_ctz(K);
+
+  __m128i a[K], b[K];
+  for (int i = 0; i < K; i++) {
+    a[i] = _mm_loadu_si128((const __m128i*)(src + i*src_stride));
+  }
+  for (int width = sizeof(T); width < 16; width *= 2) {
+    for (int p = 0; p < K/2; p++) {
+      b[p]       = unpack_lo(a[2*p], a[2*p+1], width);
+      b[p + K/2] = unpack_hi(a[2*p], a[2*p+1], width);
+    }
+    for (int i = 0; i < K; i++) {
+      a[i] = b[i];
+    }
+  }
+  for (int i = 0; i < K; i++) {
+    _mm_storeu_si128((__m128i*)(dst + reverse_low_bits(i, nr_rounds)*dst_stride), a[i]);
+  }
+}
+
+
+/*********************** Border ****************************/
+
+/* tile x tile kernel for elements of T, see Vec256Wide */
+template<typename T>
+void transpose_Vec256Wide_tile(const T* src, T* dst, int64_t src_stride, int64_t dst_stride);
+
+/* transpose rectangle [r0, r1) x [c0, c1) of src, a piece of the border */
+template<typename T>
+void transpose_Border_rect(const MatViewT<T>& src, MatViewT<T>* dst, int64_t r0, int64_t r1, int64_t c0, int64_t c1) {
+  const int64_t src_ld = src.ld(), dst_ld = dst->ld();
+  const int64_t tile = (sizeof(T) == 1) ? 8 : 32/sizeof(T);
+  const int64_t rt = r0 + (r1-r0)/tile*tile;
+  const int64_t ct = c0 + (c1-c0)/tile*tile;
+  for (int64_t r = r0; r < rt; r += tile) {
+    for (int64_t c = c0; c < ct; c += tile) {
+      const T* src_origin = src.data() + r*src_ld + c;
+            T* dst_origin = dst->data() + c*dst_ld + r;
+      if constexpr (sizeof(T) == 1) {
+        transpose_Vec_kernel<uint64_t>(src_origin, dst_origin, src_ld, dst_ld);
+      } else {
+        transpose_Vec256Wide_tile<T>(src_origin, dst_origin, src_ld, dst_ld);
+      }
+    }
+  }
+  for (int64_t r = r0; r < r1; r++) {
+    for (int64_t c = (r < rt) ? ct : c0; c < c1; c++) {
+      dst->data()[c*dst_ld + r] = src.data()[r*src_ld + c];
+    }
+  }
+}
+
+/**
+ * Transpose the part of src not covered by blocks, rows
+ * [bsize*(rows/bsize), rows) and columns [bsize*(cols/bsize), cols), which
+ * every blocked algorithm leaves out when a dimension is not a multiple of
+ * the block size. Full tiles go through a vector kernel (8x8 Vec64 for bytes,
+ * Vec256Wide for wider elements), only the remaining rows and columns are
+ * copied element by element.
+ */
+template<typename T>
+void transpose_Border(const MatViewT<T>& src, MatViewT<T>* dst) {
+  const int64_t rows = src.rows(), cols = src.cols();
+  const int64_t bsize = block_size<T>();
+  const int64_t m = rows/bsize*bsize;
+  const int64_t k = cols/bsize*bsize;
+
+  if (m < rows) {
+    transpose_Border_rect(src, dst, m, rows, 0, cols); // bottom strip, corner included
+  }
+  if (k < cols) {
+    transpose_Border_rect(src, dst, 0, m, k, cols); // right strip
+  }
 }
 
-void transpose_Vec32(const Mat& src, Mat* dst) {
+void transpose_Vec32(const MatView& src, MatView* dst) {
   transpose_Vec<uint32_t>(src, dst);
 }
 
-void transpose_Vec64(const Mat& src, Mat* dst) {
+void transpose_Vec64(const MatView& src, MatView* dst) {
   transpose_Vec<uint64_t>(src, dst);
 }
 
 
 /************************** Vec256/Vec256Buf ********************************/
 
+/* 32-byte constant, built by scalar code at startup and loaded where used */
+struct alignas(32) Mask256 {
+  uint8_t bytes[32];
+
+  operator __m256i() const;
+};
+
 /**
  * Generate AVX shuffle mask: [A0 A1 B0 B1 ...] -> [A1 A0 B1 B0 ...],
  * where A_i, B_i has size of (2^logsize) octets.
  */
-__m256i make_shuffle_mask(int logsize) {
+Mask256 make_shuffle_mask(int logsize) {
   int size = (1 << logsize);
-  uint8_t mask[32];
+  Mask256 mask;
   for (int i = 0; i < 32; i++) {
     // Coordinate geometry: (lane, block, index inside block)
     int src_lane = i / 16;
@@ -353,9 +695,9 @@ __m256i make_shuffle_mask(int logsize) {
     int dst_block = src_block;
     int dst_lane = src_lane;
 
-    mask[i] = (dst_lane * 16) + (dst_block * (2 * size)) + dst_index;
+    mask.bytes[i] = (dst_lane * 16) + (dst_block * (2 * size)) + dst_index;
   }
-  return _mm256_loadu_si256((const __m256i*) mask);
+  return mask;
 }
 
 /**
@@ -365,27 +707,68 @@ __m256i make_shuffle_mask(int logsize) {
  *   res:  [A0 A3 B0 B3 ...]
  * where A_i, B_i has size of (2^logsize) octets.
  */
-__m256i make_blendv_mask(int logsize) {
-  uint8_t mask[32];
+Mask256 make_blendv_mask(int logsize) {
+  Mask256 mask;
   for (int i = 0; i < 32; i++) {
     if ((i / (1 << logsize)) % 2 == 0) {
-      mask[i] = 0x00;
+      mask.bytes[i] = 0x00;
     } else {
-      mask[i] = 0xff;
+      mask.bytes[i] = 0xff;
     }
   }
   
-  return _mm256_loadu_si256((const __m256i*) mask);
+  return mask;
+}
+
+/* 64-byte constant, see Mask256 */
+struct alignas(64) Mask512 {
+  uint8_t bytes[64];
+
+  operator __m512i() const;
+};
+
+/**
+ * Generate vpermt2b index for round s < 16 of Vec256Vbmi. A register holds
+ * rows k and k+16 in its 32-byte halves, and in a pair of registers (k, k+s)
+ * element j of row k is kept if bit s of j is clear and is taken from
+ * element j-s of row k+s otherwise (lo), while row k+s gets element j+s of
+ * row k or keeps element j (hi).
+ */
+Mask512 make_permutex2_mask(int s, bool hi) {
+  Mask512 mask;
+  for (int i = 0; i < 64; i++) {
+    int half = i / 32, j = i % 32;
+    if (!hi) {
+      mask.bytes[i] = (j & s) ? 64 + half*32 + (j - s) : half*32 + j;
+    } else {
+      mask.bytes[i] = (j & s) ? 64 + half*32 + j : half*32 + (j + s);
+    }
+  }
+  return mask;
+}
+
+/* Generate vpermb index for round 16 of Vec256Vbmi: exchange between the halves of a register */
+Mask512 make_permute_mask() {
+  Mask512 mask;
+  for (int i = 0; i < 64; i++) {
+    int half = i / 32, j = i % 32;
+    if (half == 0) {
+      mask.bytes[i] = (j & 16) ? 32 + (j - 16) : j;
+    } else {
+      mask.bytes[i] = (j & 16) ? 32 + j : j + 16;
+    }
+  }
+  return mask;
 }
 
-static const __m256i SHUFFLE_MASK[] = {
+static const Mask256 SHUFFLE_MASK[] = {
   make_shuffle_mask(0),
   make_shuffle_mask(1),
   make_shuffle_mask(2),
   make_shuffle_mask(3),
 };
 
-static const __m256i BLENDV_MASK[] = {
+static const Mask256 BLENDV_MASK[] = {
   make_blendv_mask(0),
   make_blendv_mask(1),
   make_blendv_mask(2),
@@ -393,124 +776,1870 @@ static const __m256i BLENDV_MASK[] = {
   make_blendv_mask(4),
 };
 
+static const Mask512 PERMUTEX2_LO_MASK[] = {
+  make_permutex2_mask(1, false),
+  make_permutex2_mask(2, false),
+  make_permutex2_mask(4, false),
+  make_permutex2_mask(8, false),
+};
+
+static const Mask512 PERMUTEX2_HI_MASK[] = {
+  make_permutex2_mask(1, true),
+  make_permutex2_mask(2, true),
+  make_permutex2_mask(4, true),
+  make_permutex2_mask(8, true),
+};
+
+static const Mask512 PERMUTE_MASK = make_permute_mask();
+
+/* 32x32 kernels for the instruction sets below AVX2, prefetching 16 rows at prf_origin */
+void transpose_Vec256Scalar_kernel(const uint8_t* src_origin, uint8_t* dst_origin, const uint8_t* prf_origin, int64_t src_stride, int64_t dst_stride) {
+  for (int r = 0; r < 32; r += 8) {
+    for (int i = r/2; i < r/2 + 4; i++) {
+      _mm_prefetch(prf_origin + i*src_stride, _MM_HINT_NTA);
+    }
+    for (int c = 0; c < 32; c += 8) {
+      transpose_Vec_kernel<uint64_t>(src_origin + r*src_stride + c, dst_origin + c*dst_stride + r, src_stride, dst_stride);
+    }
+  }
+}
+
+void transpose_Vec256Sse_kernel(const uint8_t* src_origin, uint8_t* dst_origin, const uint8_t* prf_origin, int64_t src_stride, int64_t dst_stride) {
+  for (int r = 0; r < 32; r += 16) {
+    for (int i = r/2; i < r/2 + 8; i++) {
+      _mm_prefetch(prf_origin + i*src_stride, _MM_HINT_NTA);
+    }
+    for (int c = 0; c < 32; c += 16) {
+      transpose_Sse_kernel<uint8_t>(src_origin + r*src_stride + c, dst_origin + c*dst_stride + r, src_stride, dst_stride);
+    }
+  }
+}
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+inline Mask256::operator __m256i() const {
+  return _mm256_load_si256((const __m256i*) bytes);
+}
+
 #include "transpose_Vec256_kernel.h"
 
-void transpose_Vec256(const Mat& src, Mat* dst) {
-  const int64_t n = src.n();
-  for (int64_t rb = 0; rb < n/64; rb++) {
-    for (int64_t cb = 0; cb < n/64; cb++) {
-      const uint8_t* src_origin = src.data()  + (rb*n+cb)*64;
-      const uint8_t* prf_origin = next_block(src, rb, cb);
-            uint8_t* dst_origin = dst->data() + (cb*n+rb)*64;
+/* copy 64x64 block buf to dst_origin with streaming stores, rows of dst 32-byte aligned */
+void stream_block_Avx2(const uint8_t* buf, uint8_t* dst_origin, int64_t dst_ld) {
+  for (int row = 0; row < 64; row++) {
+    __m256i lane0 = _mm256_load_si256((const __m256i*)(buf + 64*row));
+    __m256i lane1 = _mm256_load_si256((const __m256i*)(buf + 64*row + 32));
+    _mm256_stream_si256((__m256i*)(dst_origin + dst_ld*row), lane0);
+    _mm256_stream_si256((__m256i*)(dst_origin + dst_ld*row + 32), lane1);
+  }
+}
+
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2,avx512f,avx512bw,avx512vl,avx512vbmi")
+#pragma GCC diagnostic push
+// GCC 12 reports _mm512_undefined_*() inside the intrinsics as uninitialized
+#pragma GCC diagnostic ignored "-Wuninitialized"
+
+inline Mask512::operator __m512i() const {
+  return _mm512_load_si512((const void*) bytes);
+}
+
+/**
+ * 32x32 kernel for AVX-512 VBMI. Register k holds rows k and k+16, so that
+ * 16 zmm registers cover the tile. Rounds s = 1, 2, 4, 8 swap off-diagonal
+ * sxs sub-blocks of every 2sx2s block with one vpermt2b per register, and
+ * round 16 swaps them between the halves of a register with vpermb: 80
+ * permutes against about 300 shuffles, blends and lane exchanges of AVX2.
+ */
+void transpose_Vec256Vbmi_kernel(const uint8_t* src_origin, uint8_t* dst_origin, const uint8_t* prf_origin, int64_t src_stride, int64_t dst_stride) {
+  __m512i r[16];
+  #pragma GCC unroll 16
+  for (int k = 0; k < 16; k++) {
+    __m256i lo = _mm256_loadu_si256((const __m256i*)(src_origin + k*src_stride));
+    __m256i hi = _mm256_loadu_si256((const __m256i*)(src_origin + (k+16)*src_stride));
+    r[k] = _mm512_inserti64x4(_mm512_castsi256_si512(lo), hi, 1);
+  }
+  #pragma GCC unroll 16
+  for (int i = 0; i < 16; i++) {
+    _mm_prefetch(prf_origin + i*src_stride, _MM_HINT_NTA);
+  }
+  #pragma GCC unroll 4
+  for (int round = 0; round < 4; round++) {
+    const int s = 1 << round;
+    const __m512i lo = PERMUTEX2_LO_MASK[round];
+    const __m512i hi = PERMUTEX2_HI_MASK[round];
+    #pragma GCC unroll 16
+    for (int k = 0; k < 16; k++) {
+      if (k & s) {
+        continue;
+      }
+      __m512i a = r[k], b = r[k+s];
+      r[k]   = _mm512_permutex2var_epi8(a, lo, b);
+      r[k+s] = _mm512_permutex2var_epi8(a, hi, b);
+    }
+  }
+  const __m512i swap = PERMUTE_MASK;
+  #pragma GCC unroll 16
+  for (int k = 0; k < 16; k++) {
+    r[k] = _mm512_permutexvar_epi8(swap, r[k]);
+    _mm256_storeu_si256((__m256i*)(dst_origin + k*dst_stride), _mm512_castsi512_si256(r[k]));
+    _mm256_storeu_si256((__m256i*)(dst_origin + (k+16)*dst_stride), _mm512_extracti64x4_epi64(r[k], 1));
+  }
+}
+
+#pragma GCC diagnostic pop
+#pragma GCC pop_options
+
+/* 32x32 kernel of given instruction set, which the CPU must support */
+inline void transpose_Isa_tile(Isa isa, const uint8_t* src_origin, uint8_t* dst_origin, const uint8_t* prf_origin, int64_t src_stride, int64_t dst_stride) {
+  switch (isa) {
+    case Isa::Scalar: transpose_Vec256Scalar_kernel(src_origin, dst_origin, prf_origin, src_stride, dst_stride); break;
+    case Isa::Sse:    transpose_Vec256Sse_kernel(src_origin, dst_origin, prf_origin, src_stride, dst_stride); break;
+    case Isa::Avx2:   transpose_Vec256_kernel(src_origin, dst_origin, prf_origin, src_stride, dst_stride); break;
+    case Isa::Avx512: transpose_Vec256Vbmi_kernel(src_origin, dst_origin, prf_origin, src_stride, dst_stride); break;
+  }
+}
+
+/**
+ * 32x32 kernel of Vec256: the AVX2 kernel, whatever wider extensions the CPU
+ * has, so that Vec256 and the algorithms built on it measure the same code
+ * on every host; SSE2 or SWAR kernels only if there is no AVX2. It is not
+ * the fastest kernel everywhere: on an AVX-512 host the SSE2 kernel is about
+ * 30% faster in cache, and both are equal once memory bound. Vec256Vbmi and
+ * Tuned use other kernels.
+ */
+inline void transpose_Vec256_tile(const uint8_t* src_origin, uint8_t* dst_origin, const uint8_t* prf_origin, int64_t src_stride, int64_t dst_stride) {
+  transpose_Isa_tile(std::min(ISA, Isa::Avx2), src_origin, dst_origin, prf_origin, src_stride, dst_stride);
+}
+
+/* rows of dst must be aligned this way for stream_block() */
+inline int64_t stream_alignment() {
+  return (ISA >= Isa::Avx2) ? 32 : 16;
+}
+
+/* copy 64x64 block buf to dst_origin with streaming stores, 32-byte ones if the CPU has AVX2 */
+inline void stream_block(const uint8_t* buf, uint8_t* dst_origin, int64_t dst_ld) {
+  if (ISA >= Isa::Avx2) {
+    stream_block_Avx2(buf, dst_origin, dst_ld);
+    return;
+  }
+  for (int row = 0; row < 64; row++) {
+    for (int col = 0; col < 64; col += 16) {
+      __m128i lane = _mm_load_si128((const __m128i*)(buf + 64*row + col));
+      _mm_stream_si128((__m128i*)(dst_origin + dst_ld*row + col), lane);
+    }
+  }
+}
+
+inline void transpose_Vec256_block(const MatView& src, MatView* dst, int64_t rb, int64_t cb) {
+  const int64_t src_ld = src.ld(), dst_ld = dst->ld();
+  const uint8_t* src_origin = src.data()  + (rb*src_ld+cb)*64;
+  const uint8_t* prf_origin = next_block(src, rb, cb);
+        uint8_t* dst_origin = dst->data() + (cb*dst_ld+rb)*64;
+
+  transpose_Vec256_tile(src_origin,                  dst_origin,                  prf_origin,             src_ld, dst_ld);
+  transpose_Vec256_tile(src_origin + 32*src_ld,      dst_origin + 32,             prf_origin + src_ld*16, src_ld, dst_ld);
+  transpose_Vec256_tile(src_origin + 32,             dst_origin + 32*dst_ld,      prf_origin + src_ld*32, src_ld, dst_ld);
+  transpose_Vec256_tile(src_origin + 32*src_ld + 32, dst_origin + 32*dst_ld + 32, prf_origin + src_ld*48, src_ld, dst_ld);
+}
 
-      transpose_Vec256_kernel(src_origin,             dst_origin,             prf_origin,        n, n);
-      transpose_Vec256_kernel(src_origin + 32*n,      dst_origin + 32,        prf_origin + n*16, n, n);
-      transpose_Vec256_kernel(src_origin + 32,        dst_origin + 32*n,      prf_origin + n*32, n, n);
-      transpose_Vec256_kernel(src_origin + 32*n + 32, dst_origin + 32*n + 32, prf_origin + n*48, n, n);
+void transpose_Vec256(const MatView& src, MatView* dst) {
+  const int64_t nrb = src.rows()/64, ncb = src.cols()/64;
+  for (int64_t rb = 0; rb < nrb; rb++) {
+    for (int64_t cb = 0; cb < ncb; cb++) {
+      transpose_Vec256_block(src, dst, rb, cb);
     }
   }
+  transpose_Border(src, dst);
+}
+
+/* buf is a 64x64 scratch block, 64-byte aligned */
+inline void transpose_Vec256Buf_block(const MatView& src, MatView* dst, int64_t rb, int64_t cb, uint8_t* buf) {
+  const int64_t src_ld = src.ld(), dst_ld = dst->ld();
+  if (dst_ld % stream_alignment() != 0 || uintptr_t(dst->data()) % stream_alignment() != 0) {
+    // rows of dst are not aligned, so streaming stores would fault,
+    // and plain stores from buf would only add a copy to Vec256
+    transpose_Vec256_block(src, dst, rb, cb);
+    return;
+  }
+  const uint8_t* src_origin = src.data()  + (rb*src_ld+cb)*64;
+  const uint8_t* prf_origin = next_block(src, rb, cb);
+        uint8_t* dst_origin = dst->data() + (cb*dst_ld+rb)*64;
+
+  transpose_Vec256_tile(src_origin,              buf,          prf_origin,           src_ld, 64);
+  transpose_Vec256_tile(src_origin+32*src_ld,    buf+32,       prf_origin+src_ld*16, src_ld, 64);
+  transpose_Vec256_tile(src_origin+32,           buf+32*64,    prf_origin+src_ld*32, src_ld, 64);
+  transpose_Vec256_tile(src_origin+32*src_ld+32, buf+32*64+32, prf_origin+src_ld*48, src_ld, 64);
+
+  stream_block(buf, dst_origin, dst_ld);
 }
 
-void transpose_Vec256Buf(const Mat& src, Mat* dst) {
-  const int64_t n = src.n();
+void transpose_Vec256Buf(const MatView& src, MatView* dst) {
+  const int64_t nrb = src.rows()/64, ncb = src.cols()/64;
   uint8_t buf[64*64] __attribute__ ((aligned (64)));
-  for (int64_t rb = 0; rb < n/64; rb++) {
-    for (int64_t cb = 0; cb < n/64; cb++) {
-      const uint8_t* src_origin = src.data()  + (rb*n+cb)*64;
+  for (int64_t rb = 0; rb < nrb; rb++) {
+    for (int64_t cb = 0; cb < ncb; cb++) {
+      transpose_Vec256Buf_block(src, dst, rb, cb, buf);
+    }
+  }
+  transpose_Border(src, dst);
+}
+
+/**
+ * Vec256 with the AVX-512 VBMI 32x32 kernel, which holds two rows per zmm
+ * register; the same as Vec256 on CPUs without VBMI.
+ */
+void transpose_Vec256Vbmi(const MatView& src, MatView* dst) {
+  const int64_t src_ld = src.ld(), dst_ld = dst->ld();
+  const int64_t nrb = src.rows()/64, ncb = src.cols()/64;
+  for (int64_t rb = 0; rb < nrb; rb++) {
+    for (int64_t cb = 0; cb < ncb; cb++) {
+      const uint8_t* src_origin = src.data()  + (rb*src_ld+cb)*64;
       const uint8_t* prf_origin = next_block(src, rb, cb);
-            uint8_t* dst_origin = dst->data() + (cb*n+rb)*64;
+            uint8_t* dst_origin = dst->data() + (cb*dst_ld+rb)*64;
+      transpose_Isa_tile(ISA, src_origin,                  dst_origin,                  prf_origin,             src_ld, dst_ld);
+      transpose_Isa_tile(ISA, src_origin + 32*src_ld,      dst_origin + 32,             prf_origin + src_ld*16, src_ld, dst_ld);
+      transpose_Isa_tile(ISA, src_origin + 32,             dst_origin + 32*dst_ld,      prf_origin + src_ld*32, src_ld, dst_ld);
+      transpose_Isa_tile(ISA, src_origin + 32*src_ld + 32, dst_origin + 32*dst_ld + 32, prf_origin + src_ld*48, src_ld, dst_ld);
+    }
+  }
+  transpose_Border(src, dst);
+}
 
-      transpose_Vec256_kernel(src_origin,         buf,          prf_origin,      n, 64);
-      transpose_Vec256_kernel(src_origin+32*n,    buf+32,       prf_origin+n*16, n, 64);
-      transpose_Vec256_kernel(src_origin+32,      buf+32*64,    prf_origin+n*32, n, 64);
-      transpose_Vec256_kernel(src_origin+32*n+32, buf+32*64+32, prf_origin+n*48, n, 64);
 
-      for (int row = 0; row < 64; row++) {
-        __m256i lane0 = *(const __m256i*)(buf + 64*row);
-        __m256i lane1 = *(const __m256i*)(buf + 64*row + 32);
-        _mm256_stream_si256((__m256i*)(dst_origin + n*row), lane0);
-        _mm256_stream_si256((__m256i*)(dst_origin + n*row + 32), lane1);
-      }
+/************************** Vec512/Vec512Buf ********************************/
+
+/**
+ * Generate vpermt2b/w/d/q index for round s of Vec512: rows k and k+s are
+ * combined as in Vec256Vbmi, with one zmm register per row, at the
+ * granularity of min(s, 8) bytes. Indices are integers of that width.
+ */
+Mask512 make_vec512_mask(int s, bool hi) {
+  const int width = std::min(s, 8);
+  const int n = 64/width, t = s/width;
+  Mask512 mask = {};
+  for (int e = 0; e < n; e++) {
+    if (!hi) {
+      mask.bytes[e*width] = (e & t) ? n + (e - t) : e;
+    } else {
+      mask.bytes[e*width] = (e & t) ? n + e : e + t;
     }
   }
+  return mask;
 }
 
-/**********************************************************/
-
-const std::unordered_map<std::string, std::function<void(const Mat&, Mat*)>> functions = {
-  {"Naive",     transpose_Naive},
-  {"Reverse",   transpose_Reverse},
-  {"Blocks",    transpose_Blocks},
-  {"BlocksPrf", transpose_BlocksPrf},
-  {"Vec32",     transpose_Vec32},
-  {"Vec64",     transpose_Vec64},
-  {"Vec256",    transpose_Vec256},
-  {"Vec256Buf", transpose_Vec256Buf}
+static const Mask512 VEC512_LO_MASK[] = {
+  make_vec512_mask(1, false),
+  make_vec512_mask(2, false),
+  make_vec512_mask(4, false),
+  make_vec512_mask(8, false),
+  make_vec512_mask(16, false),
+  make_vec512_mask(32, false),
 };
 
+static const Mask512 VEC512_HI_MASK[] = {
+  make_vec512_mask(1, true),
+  make_vec512_mask(2, true),
+  make_vec512_mask(4, true),
+  make_vec512_mask(8, true),
+  make_vec512_mask(16, true),
+  make_vec512_mask(32, true),
+};
 
-void run(int64_t n, const std::string& algo, int64_t volume, bool markers, bool verify) {
-  auto function = functions.at(algo);
+#pragma GCC push_options
+#pragma GCC target("avx2,avx512f,avx512bw,avx512vl,avx512vbmi")
+#pragma GCC diagnostic push
+// GCC 12 reports _mm512_undefined_*() inside the intrinsics as uninitialized
+#pragma GCC diagnostic ignored "-Wuninitialized"
+
+/* vpermt2 for elements of given width in bytes */
+inline __m512i permutex2(__m512i a, __m512i idx, __m512i b, int width) {
+  switch (width) {
+    case 1:  return _mm512_permutex2var_epi8(a, idx, b);
+    case 2:  return _mm512_permutex2var_epi16(a, idx, b);
+    case 4:  return _mm512_permutex2var_epi32(a, idx, b);
+    default: return _mm512_permutex2var_epi64(a, idx, b);
+  }
+}
 
-  int nr_mats = std::max<int>(volume/(n*n), 1);
-  
-  std::vector<std::unique_ptr<Mat>> srcs;
-  std::vector<std::unique_ptr<Mat>> dsts;
-  for (int i = 0; i < nr_mats; i++) {
-    srcs.push_back(std::make_unique<Mat>(n));
-    dsts.push_back(std::make_unique<Mat>(n));
+/* rounds [first, last) of Vec512 on K registers holding rows stride apart */
+template<int K>
+inline void vec512_rounds(__m512i* r, int first, int last, int stride) {
+  #pragma GCC unroll 4
+  for (int round = first; round < last; round++) {
+    const int s = 1 << round;
+    const int t = s/stride; // distance between paired registers
+    const __m512i lo = VEC512_LO_MASK[round];
+    const __m512i hi = VEC512_HI_MASK[round];
+    #pragma GCC unroll 16
+    for (int k = 0; k < K; k++) {
+      if (k & t) {
+        continue;
+      }
+      __m512i a = r[k], b = r[k+t];
+      r[k]   = permutex2(a, lo, b, std::min(s, 8));
+      r[k+t] = permutex2(a, hi, b, std::min(s, 8));
+    }
   }
+}
 
-  for (int i = 0; i < nr_mats; i++) {
-    fill_random(srcs[i].get());
+/**
+ * 64x64 kernel for AVX-512 VBMI, one row per zmm register. Round s pairs
+ * rows k and k+s and swaps off-diagonal sxs sub-blocks of every 2sx2s block,
+ * like the butterfly of Vec256Vbmi, for s = 1, 2, ..., 32. Only round 1
+ * moves single bytes (vpermt2b), later rounds move words to qwords, which
+ * are cheaper permutes. Rounds commute, so 64 rows are processed in two
+ * passes that fit in 32 registers: rounds 1..8 on 16 consecutive rows at a
+ * time, written to 64-byte aligned buf, then rounds 16 and 32 on rows k,
+ * k+16, k+32, k+48 of buf, which leave as whole 64-byte rows of dst,
+ * streamed if kStream.
+ */
+template<bool kStream>
+void transpose_Vec512_kernel(const uint8_t* src_origin, uint8_t* dst_origin, const uint8_t* prf_origin, int64_t src_stride, int64_t dst_stride, uint8_t* buf) {
+  for (int g = 0; g < 64; g += 16) {
+    __m512i r[16];
+    #pragma GCC unroll 16
+    for (int k = 0; k < 16; k++) {
+      r[k] = _mm512_loadu_si512(src_origin + (g+k)*src_stride);
+      _mm_prefetch(prf_origin + (g+k)*src_stride, _MM_HINT_NTA);
+    }
+    vec512_rounds<16>(r, 0, 4, 1);
+    #pragma GCC unroll 16
+    for (int k = 0; k < 16; k++) {
+      _mm512_store_si512(buf + (g+k)*64, r[k]);
+    }
+  }
+  for (int k = 0; k < 16; k++) {
+    __m512i r[4];
+    #pragma GCC unroll 4
+    for (int i = 0; i < 4; i++) {
+      r[i] = _mm512_load_si512(buf + (k + 16*i)*64);
+    }
+    vec512_rounds<4>(r, 4, 6, 16);
+    #pragma GCC unroll 4
+    for (int i = 0; i < 4; i++) {
+      if (kStream) {
+        _mm512_stream_si512((__m512i*)(dst_origin + (k + 16*i)*dst_stride), r[i]);
+      } else {
+        _mm512_storeu_si512(dst_origin + (k + 16*i)*dst_stride, r[i]);
+      }
+    }
   }
+}
 
-  for (int i = 0; i < nr_mats; i++) {
-    explicit_bzero(dsts[i]->data(), n*n);
+#pragma GCC diagnostic pop
+#pragma GCC pop_options
+
+/**
+ * Vec512 and Vec512Buf differ only in how rows leave the kernel: regular or
+ * streaming stores, as Vec256 and Vec256Buf. Without AVX-512 VBMI, or when
+ * rows of dst are not 64-byte aligned for streaming, they fall back to Vec256
+ * and Vec256Buf.
+ */
+template<bool kStream>
+void transpose_Vec512_blocks(const MatView& src, MatView* dst) {
+  const int64_t src_ld = src.ld(), dst_ld = dst->ld();
+  const int64_t nrb = src.rows()/64, ncb = src.cols()/64;
+  uint8_t buf[64*64] __attribute__ ((aligned (64)));
+  for (int64_t rb = 0; rb < nrb; rb++) {
+    for (int64_t cb = 0; cb < ncb; cb++) {
+      const uint8_t* src_origin = src.data()  + (rb*src_ld+cb)*64;
+      const uint8_t* prf_origin = next_block(src, rb, cb);
+            uint8_t* dst_origin = dst->data() + (cb*dst_ld+rb)*64;
+      transpose_Vec512_kernel<kStream>(src_origin, dst_origin, prf_origin, src_ld, dst_ld, buf);
+    }
   }
-  
-  if (markers) {
-    printf("PERF-BEGIN\n");
-    fflush(stdout);
+  transpose_Border(src, dst);
+}
+
+void transpose_Vec512(const MatView& src, MatView* dst) {
+  if (ISA < Isa::Avx512) {
+    transpose_Vec256(src, dst);
+    return;
   }
-  int64_t ts1 = rdtscp();
-  for (int i = 0; i < nr_mats; i++) {
-    function(*srcs[i], dsts[i].get());
+  transpose_Vec512_blocks<false>(src, dst);
+}
+
+void transpose_Vec512Buf(const MatView& src, MatView* dst) {
+  if (ISA < Isa::Avx512 || dst->ld() % 64 != 0 || uintptr_t(dst->data()) % 64 != 0) {
+    transpose_Vec256Buf(src, dst);
+    return;
   }
-  int64_t ts2 = rdtscp();
-  if (markers) {
-    printf("PERF-END\n");
-    fflush(stdout);
+  transpose_Vec512_blocks<true>(src, dst);
+}
+
+
+/************************** Recursive ********************************/
+
+/**
+ * Cache-oblivious transpose (Frigo et al., 1999): the range of 64x64 blocks
+ * [rb0, rb1) x [cb0, cb1) is bisected along its longer side, so that at some
+ * depth both the src and the dst part of a subproblem fit in every level of
+ * cache, whatever its size and associativity. A single block is transposed
+ * by the Vec256 kernel, prefetching block (next_rb, next_cb), the first one
+ * visited after the range is done.
+ */
+void transpose_Recursive_range(const MatView& src, MatView* dst, int64_t rb0, int64_t rb1, int64_t cb0, int64_t cb1, int64_t next_rb, int64_t next_cb) {
+  const int64_t src_ld = src.ld(), dst_ld = dst->ld();
+  if (rb1 - rb0 == 1 && cb1 - cb0 == 1) {
+    const uint8_t* src_origin = src.data()  + (rb0*src_ld+cb0)*64;
+    const uint8_t* prf_origin = src.data()  + (next_rb*src_ld+next_cb)*64;
+          uint8_t* dst_origin = dst->data() + (cb0*dst_ld+rb0)*64;
+    transpose_Vec256_tile(src_origin,                  dst_origin,                  prf_origin,             src_ld, dst_ld);
+    transpose_Vec256_tile(src_origin + 32*src_ld,      dst_origin + 32,             prf_origin + src_ld*16, src_ld, dst_ld);
+    transpose_Vec256_tile(src_origin + 32,             dst_origin + 32*dst_ld,      prf_origin + src_ld*32, src_ld, dst_ld);
+    transpose_Vec256_tile(src_origin + 32*src_ld + 32, dst_origin + 32*dst_ld + 32, prf_origin + src_ld*48, src_ld, dst_ld);
+  } else if (rb1 - rb0 >= cb1 - cb0) {
+    const int64_t rbm = (rb0 + rb1)/2;
+    transpose_Recursive_range(src, dst, rb0, rbm, cb0, cb1, rbm, cb0);
+    transpose_Recursive_range(src, dst, rbm, rb1, cb0, cb1, next_rb, next_cb);
+  } else {
+    const int64_t cbm = (cb0 + cb1)/2;
+    transpose_Recursive_range(src, dst, rb0, rb1, cb0, cbm, rb0, cbm);
+    transpose_Recursive_range(src, dst, rb0, rb1, cbm, cb1, next_rb, next_cb);
   }
+}
 
-  if (verify) {
-    for (int i = 0; i < nr_mats; i++) {
-      check_transpose(*srcs[i], *dsts[i]);
-    }
+void transpose_Recursive(const MatView& src, MatView* dst) {
+  const int64_t nrb = src.rows()/64, ncb = src.cols()/64;
+  if (nrb > 0 && ncb > 0) {
+    transpose_Recursive_range(src, dst, 0, nrb, 0, ncb, 0, 0);
   }
+  transpose_Border(src, dst);
+}
 
-  printf("%15s %7ld %10.6f %d\n",
-    algo.c_str(),
-    n,
-    double(ts2-ts1)/nr_mats/n/n, // cycles per element
-    nr_mats
-  );
-  fflush(stdout);
+
+/************************** Tuned ********************************/
+
+/**
+ * Parameters of transpose_Tunable(), which are fixed in the other
+ * algorithms: 64x64 blocks are visited in row-major order inside groups of
+ * block x block bytes, the block prefetch_distance steps ahead in that order
+ * is prefetched with NTA or T0 hint (distance 0: no prefetch), and dst is
+ * written with regular stores or, through a 64x64 buffer, with streaming
+ * stores, and 32x32 tiles go through the kernel of instruction set kernel.
+ * {64, 1, true, false, avx2} is Vec256, {64, 1, true, true, avx2} is
+ * Vec256Buf.
+ */
+struct TuneParams {
+  int64_t block; // multiple of 64
+  int prefetch_distance;
+  bool prefetch_nta;
+  bool stream;
+  Isa kernel; // at most ISA
+};
+
+/* block after (rb, cb) in the order of transpose_Tunable(), (nrb, 0) after the last one */
+inline void next_tuned_block(int64_t nrb, int64_t ncb, int64_t group, int64_t* rb, int64_t* cb) {
+  const int64_t gr = *rb/group*group, gc = *cb/group*group;
+  if (*cb + 1 < std::min(gc + group, ncb)) {
+    *cb += 1;
+  } else if (*rb + 1 < std::min(gr + group, nrb)) {
+    *rb += 1;
+    *cb = gc;
+  } else if (gc + group < ncb) {
+    *rb = gr;
+    *cb = gc + group;
+  } else {
+    *rb = gr + group;
+    *cb = 0;
+  }
 }
 
+void transpose_Tunable(const MatView& src, MatView* dst, const TuneParams& params) {
+  ensure(params.block >= 64 && params.block % 64 == 0 && params.prefetch_distance >= 0 && params.kernel <= ISA);
+  const int64_t src_ld = src.ld(), dst_ld = dst->ld();
+  const int64_t nrb = src.rows()/64, ncb = src.cols()/64;
+  const int64_t group = params.block/64;
+  // rows of dst must be aligned for streaming stores, see Vec256Buf
+  const bool stream = params.stream && dst_ld % stream_alignment() == 0 && uintptr_t(dst->data()) % stream_alignment() == 0;
+  uint8_t buf[64*64] __attribute__ ((aligned (64)));
+
+  for (int64_t rb = 0, cb = 0; nrb > 0 && ncb > 0 && rb < nrb; next_tuned_block(nrb, ncb, group, &rb, &cb)) {
+    const uint8_t* src_origin = src.data()  + (rb*src_ld+cb)*64;
+          uint8_t* dst_origin = dst->data() + (cb*dst_ld+rb)*64;
 
-int main(int argc, char* argv[]) {
-  if (argc != 6) {
-    printf("Usage: %s <n> <algorithm> <volume> <markers> <verify>\n", argv[0]);
-    return 1;
+    if (params.prefetch_distance > 0) {
+      int64_t prb = rb, pcb = cb;
+      for (int i = 0; i < params.prefetch_distance; i++) {
+        next_tuned_block(nrb, ncb, group, &prb, &pcb);
+      }
+      if (prb < nrb) {
+        const uint8_t* prf_origin = src.data() + (prb*src_ld+pcb)*64;
+        for (int64_t r = 0; r < 64; r++) {
+          if (params.prefetch_nta) {
+            _mm_prefetch(prf_origin + r*src_ld, _MM_HINT_NTA);
+          } else {
+            _mm_prefetch(prf_origin + r*src_ld, _MM_HINT_T0);
+          }
+        }
+      }
+    }
+
+    // kernels prefetch the block they transpose, which is a no-op
+          uint8_t* out    = stream ? buf : dst_origin;
+    const int64_t  out_ld = stream ? 64 : dst_ld;
+    transpose_Isa_tile(params.kernel, src_origin,                  out,                  src_origin,             src_ld, out_ld);
+    transpose_Isa_tile(params.kernel, src_origin + 32*src_ld,      out + 32,             src_origin + src_ld*16, src_ld, out_ld);
+    transpose_Isa_tile(params.kernel, src_origin + 32,             out + 32*out_ld,      src_origin + src_ld*32, src_ld, out_ld);
+    transpose_Isa_tile(params.kernel, src_origin + 32*src_ld + 32, out + 32*out_ld + 32, src_origin + src_ld*48, src_ld, out_ld);
+
+    if (stream) {
+      stream_block(buf, dst_origin, dst_ld);
+    }
+  }
+  if (stream) {
+    _mm_sfence();
+  }
+  transpose_Border(src, dst);
+}
+
+/**
+ * Tuning results, in the spirit of FFTW wisdom: the fastest TuneParams found
+ * by "transpose tune" for an instruction set and a shape, one line per entry
+ *   <isa> <rows>x<cols> <kernel> <block> <prefetch distance> nta|t0 regular|stream <cycles per element>
+ * in file $TRANSPOSE_WISDOM, transpose.wisdom in the working directory by
+ * default. The file is loaded by the first transpose_Tuned() call.
+ */
+class Wisdom {
+public:
+  static std::string path() {
+    const char* env = getenv("TRANSPOSE_WISDOM");
+    return env ? env : "transpose.wisdom";
   }
-  int64_t n = std::stoll(argv[1]);
-  std::string algorithm(argv[2]);
-  int64_t volume = std::stoll(argv[3]);
-  int markers = atoi(argv[4]);
-  int verify = atoi(argv[5]);
 
-  run(n, algorithm, volume, markers, verify);
+  /* a missing file is empty wisdom */
+  void load(const std::string& path) {
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+      if (line.empty() || line[0] == '#') {
+        continue;
+      }
+      std::istringstream tokens(line);
+      Entry entry;
+      std::string shape, kernel, hint, store;
+      tokens >> entry.isa >> shape >> kernel >> entry.params.block >> entry.params.prefetch_distance >> hint >> store >> entry.cpe;
+      ensure(tokens && (hint == "nta" || hint == "t0") && (store == "regular" || store == "stream"));
+      size_t x = shape.find('x');
+      ensure(x != std::string::npos);
+      entry.rows = std::stoll(shape.substr(0, x));
+      entry.cols = std::stoll(shape.substr(x + 1));
+      entry.params.prefetch_nta = (hint == "nta");
+      entry.params.stream = (store == "stream");
+      entry.params.kernel = parse_isa(kernel);
+      _entries.push_back(entry);
+    }
+  }
+
+  void save(const std::string& path) const {
+    std::ofstream out(path);
+    for (const Entry& e : _entries) {
+      out << e.isa << ' ' << e.rows << 'x' << e.cols << ' '
+          << isa_name(e.params.kernel) << ' ' << e.params.block << ' ' << e.params.prefetch_distance << ' '
+          << (e.params.prefetch_nta ? "nta" : "t0") << ' '
+          << (e.params.stream ? "stream" : "regular") << ' '
+          << e.cpe << '\n';
+    }
+    ensure(out.good());
+  }
+
+  /* replaces the entry of the same instruction set and shape */
+  void put(Isa isa, int64_t rows, int64_t cols, const TuneParams& params, double cpe) {
+    Entry entry = {isa_name(isa), rows, cols, params, cpe};
+    for (Entry& e : _entries) {
+      if (e.isa == entry.isa && e.rows == rows && e.cols == cols) {
+        e = entry;
+        return;
+      }
+    }
+    _entries.push_back(entry);
+  }
+
+  /* entry of given instruction set with the nearest shape, Vec256 parameters if none */
+  TuneParams get(Isa isa, int64_t rows, int64_t cols) const {
+    TuneParams params = {64, 1, true, false, std::min(ISA, Isa::Avx2)};
+    double best = std::numeric_limits<double>::infinity();
+    for (const Entry& e : _entries) {
+      double distance = std::abs(std::log(double(e.rows)/rows)) + std::abs(std::log(double(e.cols)/cols));
+      if (e.isa == isa_name(isa) && distance < best) {
+        best = distance;
+        params = e.params;
+      }
+    }
+    return params;
+  }
+
+private:
+  struct Entry {
+    std::string isa;
+    int64_t rows;
+    int64_t cols;
+    TuneParams params;
+    double cpe;
+  };
+
+  std::vector<Entry> _entries;
+};
+
+Wisdom& wisdom() {
+  static Wisdom wisdom = [] {
+    Wisdom wisdom;
+    wisdom.load(Wisdom::path());
+    return wisdom;
+  }();
+  return wisdom;
+}
+
+/* transpose_Tunable() with parameters from wisdom */
+void transpose_Tuned(const MatView& src, MatView* dst) {
+  transpose_Tunable(src, dst, wisdom().get(ISA, src.rows(), src.cols()));
+}
+
+
+/************************** InPlace ********************************/
+
+/**
+ * In-place transpose of a square matrix: no second matrix is needed, which
+ * halves the memory footprint. Blocks (rb, cb) and (cb, rb) are swapped
+ * pairwise: the upper block is transposed into buf, the lower block is
+ * transposed straight into the place of the upper one, and buf is copied
+ * into the place of the lower one. Diagonal blocks make a round trip through
+ * buf. Elements outside of 64x64 blocks, at most 63 rows and columns, are
+ * swapped one by one.
+ */
+void transpose_InPlace(MatView* mat) {
+  ensure(mat->rows() == mat->cols());
+  const int64_t n = mat->rows(), ld = mat->ld();
+  const int64_t nb = n/64;
+  uint8_t* data = mat->data();
+  uint8_t buf[64*64] __attribute__ ((aligned (64)));
+
+  auto block = [&](int64_t rb, int64_t cb) { return data + (rb*ld + cb)*64; };
+
+  // transpose 64x64 block at src into dst, prefetching block at prf
+  auto transpose_block = [](const uint8_t* src, int64_t src_ld, uint8_t* dst, int64_t dst_ld, const uint8_t* prf) {
+    transpose_Vec256_tile(src,                  dst,                  prf,             src_ld, dst_ld);
+    transpose_Vec256_tile(src + 32*src_ld,      dst + 32,             prf + src_ld*16, src_ld, dst_ld);
+    transpose_Vec256_tile(src + 32,             dst + 32*dst_ld,      prf + src_ld*32, src_ld, dst_ld);
+    transpose_Vec256_tile(src + 32*src_ld + 32, dst + 32*dst_ld + 32, prf + src_ld*48, src_ld, dst_ld);
+  };
+
+  auto copy_block = [&](uint8_t* dst) {
+    for (int row = 0; row < 64; row++) {
+      memcpy(dst + ld*row, buf + 64*row, 64);
+    }
+  };
+
+  for (int64_t rb = 0; rb < nb; rb++) {
+    uint8_t* diag = block(rb, rb);
+    transpose_block(diag, ld, buf, 64, block(rb, rb+1));
+    copy_block(diag);
+    for (int64_t cb = rb+1; cb < nb; cb++) {
+      uint8_t* upper = block(rb, cb);
+      uint8_t* lower = block(cb, rb);
+      transpose_block(upper, ld, buf, 64, block(rb, cb+1));
+      transpose_block(lower, ld, upper, ld, block(cb+1, rb));
+      copy_block(lower);
+    }
+  }
+
+  for (int64_t r = nb*64; r < n; r++) {
+    for (int64_t c = 0; c < r; c++) {
+      std::swap(data[r*ld + c], data[c*ld + r]);
+    }
+  }
+}
+
+
+/************************** Vec256Wide ********************************/
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+/* _mm256_unpacklo/hi for elements of given width in bytes, inside 128-bit lanes */
+inline __m256i unpack_lo(__m256i a, __m256i b, int width) {
+  switch (width) {
+    case 2:  return _mm256_unpacklo_epi16(a, b);
+    case 4:  return _mm256_unpacklo_epi32(a, b);
+    default: return _mm256_unpacklo_epi64(a, b);
+  }
+}
+
+inline __m256i unpack_hi(__m256i a, __m256i b, int width) {
+  switch (width) {
+    case 2:  return _mm256_unpackhi_epi16(a, b);
+    case 4:  return _mm256_unpackhi_epi32(a, b);
+    default: return _mm256_unpackhi_epi64(a, b);
+  }
+}
+
+/**
+ * Transpose KxK tile of T, K = 32/sizeof(T), one row per AVX register:
+ * 16x16 uint16_t, 8x8 uint32_t or 4x4 uint64_t. Every round interleaves rows
+ * 2p and 2p+1 at twice the element width of the previous round, low halves go
+ * to row p and high halves to row p+K/2. After log2(K)-1 unpack rounds
+ * permute2x128 exchanges 128-bit lanes the same way, and register i holds
+ * column reverse_low_bits(i, log2(K)-1). Loops have constant trip counts and
+ * are unrolled by the compiler.
+ */
+template<typename T>
+void transpose_Vec256Wide_kernel(const T* src, T* dst, int64_t src_stride, int64_t dst_stride) {
+  static_assert(sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8, "2-, 4- or 8-byte elements");
+  constexpr int K = 32/sizeof(T);
+  constexpr int nr_unpack_rounds = __builtin_ctz(K) - 1;
+
+  __m256i a[K], b[K];
+  for (int i = 0; i < K; i++) {
+    a[i] = _mm256_loadu_si256((const __m256i*)(src + i*src_stride));
+  }
+  for (int width = sizeof(T); width < 16; width *= 2) {
+    for (int p = 0; p < K/2; p++) {
+      b[p]       = unpack_lo(a[2*p], a[2*p+1], width);
+      b[p + K/2] = unpack_hi(a[2*p], a[2*p+1], width);
+    }
+    for (int i = 0; i < K; i++) {
+      a[i] = b[i];
+    }
+  }
+  for (int p = 0; p < K/2; p++) {
+    b[p]       = _mm256_permute2x128_si256(a[2*p], a[2*p+1], 0x20);
+    b[p + K/2] = _mm256_permute2x128_si256(a[2*p], a[2*p+1], 0x31);
+  }
+  for (int i = 0; i < K; i++) {
+    _mm256_storeu_si256((__m256i*)(dst + reverse_low_bits(i, nr_unpack_rounds)*dst_stride), b[i]);
+  }
+}
+
+#pragma GCC pop_options
+
+/**
+ * KxK tile for the instruction set of this CPU: the AVX2 kernel above (also
+ * on AVX-512 hosts, as 2- to 8-byte elements need no byte permutes), 2x2 SSE2
+ * kernels, or a plain copy.
+ */
+template<typename T>
+void transpose_Vec256Wide_tile(const T* src, T* dst, int64_t src_stride, int64_t dst_stride) {
+  constexpr int K = 32/sizeof(T);
+  if (ISA >= Isa::Avx2) {
+    transpose_Vec256Wide_kernel<T>(src, dst, src_stride, dst_stride);
+  } else if (ISA == Isa::Sse) {
+    transpose_Sse_kernel<T>(src,                        dst,                        src_stride, dst_stride);
+    transpose_Sse_kernel<T>(src + K/2*src_stride,       dst + K/2,                  src_stride, dst_stride);
+    transpose_Sse_kernel<T>(src + K/2,                  dst + K/2*dst_stride,       src_stride, dst_stride);
+    transpose_Sse_kernel<T>(src + K/2*src_stride + K/2, dst + K/2*dst_stride + K/2, src_stride, dst_stride);
+  } else {
+    for (int r = 0; r < K; r++) {
+      for (int c = 0; c < K; c++) {
+        dst[c*dst_stride + r] = src[r*src_stride + c];
+      }
+    }
+  }
+}
+
+/**
+ * Vec256 for 2-, 4- and 8-byte elements: blocks are one cache line wide, as
+ * for bytes, and every block is transposed with 2x2 calls of the KxK kernel.
+ */
+template<typename T>
+void transpose_Vec256Wide(const MatViewT<T>& src, MatViewT<T>* dst) {
+  const int64_t src_ld = src.ld(), dst_ld = dst->ld();
+  const int64_t bsize = block_size<T>();
+  const int64_t tile = bsize/2;
+  const int64_t nrb = src.rows()/bsize, ncb = src.cols()/bsize;
+  for (int64_t rb = 0; rb < nrb; rb++) {
+    for (int64_t cb = 0; cb < ncb; cb++) {
+      const T* src_origin = src.data()  + (rb*src_ld+cb)*bsize;
+      const T* prf_origin = next_block(src, rb, cb);
+            T* dst_origin = dst->data() + (cb*dst_ld+rb)*bsize;
+      for (int64_t r = 0; r < bsize; r++) {
+        _mm_prefetch(prf_origin + r*src_ld, _MM_HINT_NTA);
+      }
+      transpose_Vec256Wide_tile<T>(src_origin,                      dst_origin,                      src_ld, dst_ld);
+      transpose_Vec256Wide_tile<T>(src_origin + tile*src_ld,        dst_origin + tile,               src_ld, dst_ld);
+      transpose_Vec256Wide_tile<T>(src_origin + tile,               dst_origin + tile*dst_ld,        src_ld, dst_ld);
+      transpose_Vec256Wide_tile<T>(src_origin + tile*src_ld + tile, dst_origin + tile*dst_ld + tile, src_ld, dst_ld);
+    }
+  }
+  transpose_Border(src, dst);
+}
+
+
+/************************** Multi-threaded Vec256/Vec256Buf ********************************/
+
+/**
+ * Fork-join pool: run(nr_threads, task) calls task(0), ..., task(nr_threads-1)
+ * in parallel and returns when all of them are done. Workers are kept alive
+ * between calls, so that small matrices do not pay for thread creation.
+ */
+class ThreadPool {
+public:
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop = true;
+      _generation++;
+    }
+    _start.notify_all();
+    for (std::thread& worker : _workers) {
+      worker.join();
+    }
+  }
+
+  void run(int nr_threads, const std::function<void(int)>& task) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while ((int)_workers.size() < nr_threads - 1) {
+      int tid = _workers.size() + 1;
+      _workers.emplace_back([this, tid, generation = _generation]() { work(tid, generation); });
+    }
+    _task = &task;
+    _nr_threads = nr_threads;
+    _nr_running = nr_threads - 1;
+    _generation++;
+    lock.unlock();
+    _start.notify_all();
+
+    task(0);
+
+    lock.lock();
+    _done.wait(lock, [this]() { return _nr_running == 0; });
+  }
+
+private:
+  void work(int tid, uint64_t generation) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+      _start.wait(lock, [&]() { return _generation != generation; });
+      generation = _generation;
+      if (_stop) {
+        return;
+      }
+      if (tid >= _nr_threads) {
+        continue;
+      }
+      const std::function<void(int)>* task = _task;
+      lock.unlock();
+      (*task)(tid);
+      lock.lock();
+      if (--_nr_running == 0) {
+        _done.notify_one();
+      }
+    }
+  }
+
+  std::mutex _mutex;
+  std::condition_variable _start;
+  std::condition_variable _done;
+  std::vector<std::thread> _workers;
+  const std::function<void(int)>* _task = nullptr;
+  int _nr_threads = 0;
+  int _nr_running = 0;
+  uint64_t _generation = 0;
+  bool _stop = false;
+};
+
+ThreadPool& thread_pool() {
+  static ThreadPool pool;
+  return pool;
+}
+
+/**
+ * NUMA nodes and their CPUs as listed in /sys/devices/system/node. In NUMA
+ * mode thread t of a parallel transpose runs on node t*nr_nodes/nr_threads,
+ * so threads are spread evenly over nodes, and matrix pages are placed by
+ * first touch. Raw syscalls are used, there is no dependency on libnuma.
+ */
+class Numa {
+public:
+  void enable() {
+    for (int node = 0; ; node++) {
+      std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+      if (!in) {
+        break;
+      }
+      std::string cpulist;
+      std::getline(in, cpulist);
+      _cpus.push_back(parse_cpulist(cpulist));
+    }
+    if (_cpus.empty()) {
+      // no NUMA in sysfs: a single node with every CPU
+      std::vector<int> all(std::max<int>(std::thread::hardware_concurrency(), 1));
+      std::iota(all.begin(), all.end(), 0);
+      _cpus.push_back(all);
+    }
+    _enabled = true;
+  }
+
+  bool enabled() const { return _enabled; }
+
+  int nr_nodes() const { return _cpus.size(); }
+
+  int node_of_thread(int tid, int nr_threads) const {
+    return int64_t(tid) * nr_nodes() / nr_threads;
+  }
+
+  /**
+   * Binds the calling thread to the CPUs of its node while in scope. Thread 0
+   * of a parallel transpose is the caller of ThreadPool::run(), so its
+   * previous affinity is restored afterwards.
+   */
+  class Pin {
+  public:
+    Pin(const Numa& numa, int tid, int nr_threads) {
+      ensure(sched_getaffinity(0, sizeof(_saved), &_saved) == 0);
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      for (int cpu : numa._cpus[numa.node_of_thread(tid, nr_threads)]) {
+        CPU_SET(cpu, &set);
+      }
+      ensure(sched_setaffinity(0, sizeof(set), &set) == 0);
+    }
+    ~Pin() {
+      sched_setaffinity(0, sizeof(_saved), &_saved);
+    }
+    Pin(const Pin&) = delete;
+    Pin& operator=(const Pin&) = delete;
+  private:
+    cpu_set_t _saved;
+  };
+
+  /* time thread tid spent on its blocks in transpose_Static(), summed over calls since reset */
+  void reset_thread_seconds(int nr_threads) { _thread_seconds.assign(nr_threads, 0.0); }
+  void add_thread_seconds(int tid, double seconds) { _thread_seconds[tid] += seconds; }
+  double thread_seconds(int tid) const { return _thread_seconds[tid]; }
+
+  /* node of every page of [data, data+size), -1 if the page is not present */
+  std::vector<int> nodes_of_pages(const uint8_t* data, int64_t size) const {
+    const int64_t page_size = sysconf(_SC_PAGESIZE);
+    const uint8_t* begin = (const uint8_t*)(uintptr_t(data) & ~uintptr_t(page_size - 1));
+    int64_t nr_pages = (data + size - begin + page_size - 1) / page_size;
+    std::vector<int> nodes(nr_pages);
+    std::vector<void*> pages;
+    const int64_t batch = 4096;
+    for (int64_t first = 0; first < nr_pages; first += batch) {
+      int64_t count = std::min(batch, nr_pages - first);
+      pages.resize(count);
+      for (int64_t i = 0; i < count; i++) {
+        pages[i] = (void*)(begin + (first + i) * page_size);
+      }
+      // move_pages() with nodes == NULL only queries placement
+      ensure(syscall(SYS_move_pages, 0, count, pages.data(), nullptr, nodes.data() + first, 0) == 0);
+      for (int64_t i = first; i < first + count; i++) {
+        nodes[i] = std::max(nodes[i], -1);
+      }
+    }
+    return nodes;
+  }
+
+  /* node of the page holding addr, given nodes_of_pages() of a region starting at data */
+  static int node_of(const std::vector<int>& nodes, const uint8_t* data, const uint8_t* addr) {
+    const int64_t page_size = sysconf(_SC_PAGESIZE);
+    uintptr_t begin = uintptr_t(data) & ~uintptr_t(page_size - 1);
+    return nodes[(uintptr_t(addr) - begin) / page_size];
+  }
+
+private:
+  /* "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11} */
+  static std::vector<int> parse_cpulist(const std::string& cpulist) {
+    std::vector<int> cpus;
+    size_t pos = 0;
+    while (pos < cpulist.size()) {
+      size_t comma = std::min(cpulist.find(',', pos), cpulist.size());
+      std::string range = cpulist.substr(pos, comma - pos);
+      size_t dash = range.find('-');
+      int first = std::stoi(range.substr(0, dash));
+      int last = (dash == std::string::npos) ? first : std::stoi(range.substr(dash + 1));
+      for (int cpu = first; cpu <= last; cpu++) {
+        cpus.push_back(cpu);
+      }
+      pos = comma + 1;
+    }
+    return cpus;
+  }
+
+  bool _enabled = false;
+  std::vector<std::vector<int>> _cpus;
+  std::vector<double> _thread_seconds; // each thread writes only its own element
+};
+
+Numa numa;
+
+/**
+ * Share of thread t in the border of a parallel transpose, see
+ * transpose_Border(). The bottom strip is split at block columns of src with
+ * the NUMA-mode stripes of transpose_Static(), the last thread taking the
+ * corner. The right strip goes to dst rows past the last block column, which
+ * first_touch() places with the last thread, so in NUMA mode the last thread
+ * takes all of it; otherwise it is split at block rows of src like the
+ * stripes of transpose_Static().
+ */
+void transpose_Border_part(const MatView& src, MatView* dst, int tid, int nr_threads) {
+  const int64_t rows = src.rows(), cols = src.cols();
+  const int64_t nrb = rows/64, ncb = cols/64;
+  const int64_t m = 64*nrb, k = 64*ncb;
+  const bool last = (tid == nr_threads-1);
+  if (m < rows) {
+    int64_t c0 = 64*(ncb*tid/nr_threads);
+    int64_t c1 = last ? cols : 64*(ncb*(tid+1)/nr_threads);
+    transpose_Border_rect(src, dst, m, rows, c0, c1);
+  }
+  if (k < cols) {
+    if (numa.enabled()) {
+      if (last) {
+        transpose_Border_rect(src, dst, 0, m, k, cols);
+      }
+    } else {
+      transpose_Border_rect(src, dst, 64*(nrb*tid/nr_threads), 64*(nrb*(tid+1)/nr_threads), k, cols);
+    }
+  }
+}
+
+/**
+ * Static stripes: thread t transposes block rows [t*nrb/T, (t+1)*nrb/T) of src,
+ * which are block columns of dst. In NUMA mode stripes are block rows of dst
+ * instead, so that every thread writes only pages that it has touched first,
+ * see first_touch(); reads may be remote, but they need no RFO.
+ * Block is called as block(rb, cb, buf), where buf is a 64x64 scratch block
+ * private to the thread. The border is transposed by the same threads, see
+ * transpose_Border_part().
+ */
+template<typename Block>
+void transpose_Static(const MatView& src, MatView* dst, int nr_threads, Block block) {
+  const int64_t nrb = src.rows()/64, ncb = src.cols()/64;
+  thread_pool().run(nr_threads, [&](int tid) {
+    uint8_t buf[64*64] __attribute__ ((aligned (64)));
+    if (numa.enabled()) {
+      Numa::Pin pin(numa, tid, nr_threads);
+      auto time1 = std::chrono::steady_clock::now();
+      for (int64_t rb = 0; rb < nrb; rb++) {
+        for (int64_t cb = ncb*tid/nr_threads; cb < ncb*(tid+1)/nr_threads; cb++) {
+          block(rb, cb, buf);
+        }
+      }
+      transpose_Border_part(src, dst, tid, nr_threads);
+      _mm_sfence(); // count draining of streaming stores towards the node
+      auto time2 = std::chrono::steady_clock::now();
+      numa.add_thread_seconds(tid, std::chrono::duration<double>(time2 - time1).count());
+    } else {
+      for (int64_t rb = nrb*tid/nr_threads; rb < nrb*(tid+1)/nr_threads; rb++) {
+        for (int64_t cb = 0; cb < ncb; cb++) {
+          block(rb, cb, buf);
+        }
+      }
+      transpose_Border_part(src, dst, tid, nr_threads);
+    }
+    _mm_sfence(); // streaming stores must be visible once run() returns
+  });
+}
+
+/**
+ * Range [begin, end) of block indices (rb*ncb+cb) owned by a thread, packed
+ * into one word: the owner takes blocks from the front, an idle thread steals
+ * the back half, and both sides update the range with a single CAS.
+ */
+struct alignas(64) BlockRange {
+  static uint64_t pack(uint32_t begin, uint32_t end) { return (uint64_t(end) << 32) | begin; }
+
+  bool take_front(int64_t* block) {
+    uint64_t cur = range.load(std::memory_order_relaxed);
+    while (true) {
+      uint32_t begin = cur, end = cur >> 32;
+      if (begin >= end) {
+        return false;
+      }
+      if (range.compare_exchange_weak(cur, pack(begin+1, end))) {
+        *block = begin;
+        return true;
+      }
+    }
+  }
+
+  bool steal_back(uint32_t* stolen_begin, uint32_t* stolen_end) {
+    uint64_t cur = range.load(std::memory_order_relaxed);
+    while (true) {
+      uint32_t begin = cur, end = cur >> 32;
+      if (begin >= end) {
+        return false;
+      }
+      uint32_t mid = end - (end - begin + 1)/2;
+      if (range.compare_exchange_weak(cur, pack(begin, mid))) {
+        *stolen_begin = mid;
+        *stolen_end = end;
+        return true;
+      }
+    }
+  }
+
+  std::atomic<uint64_t> range;
+};
+
+/**
+ * Work stealing: threads start with the same stripes as in transpose_Static()
+ * and, when done, steal half of the remaining blocks of another thread.
+ * Every thread transposes its share of the border first, so that stealing
+ * evens it out.
+ */
+template<typename Block>
+void transpose_Steal(const MatView& src, MatView* dst, int nr_threads, Block block) {
+  const int64_t ncb = src.cols()/64;
+  const int64_t nb = src.rows()/64*ncb;
+  ensure(nb <= UINT32_MAX);
+  ensure(!numa.enabled()); // stolen blocks would be written remotely
+  std::unique_ptr<BlockRange[]> ranges(new BlockRange[nr_threads]);
+  for (int tid = 0; tid < nr_threads; tid++) {
+    ranges[tid].range = BlockRange::pack(nb*tid/nr_threads, nb*(tid+1)/nr_threads);
+  }
+  thread_pool().run(nr_threads, [&](int tid) {
+    uint8_t buf[64*64] __attribute__ ((aligned (64)));
+    BlockRange& own = ranges[tid];
+    transpose_Border_part(src, dst, tid, nr_threads);
+    while (true) {
+      int64_t b;
+      while (own.take_front(&b)) {
+        block(b/ncb, b%ncb, buf);
+      }
+      uint32_t stolen_begin, stolen_end;
+      bool stolen = false;
+      for (int i = 1; i < nr_threads && !stolen; i++) {
+        stolen = ranges[(tid+i) % nr_threads].steal_back(&stolen_begin, &stolen_end);
+      }
+      if (!stolen) {
+        break;
+      }
+      own.range.store(BlockRange::pack(stolen_begin, stolen_end));
+    }
+    _mm_sfence();
+  });
+}
+
+void transpose_Vec256Static(const MatView& src, MatView* dst, int nr_threads) {
+  transpose_Static(src, dst, nr_threads, [&](int64_t rb, int64_t cb, uint8_t*) {
+    transpose_Vec256_block(src, dst, rb, cb);
+  });
+}
+
+void transpose_Vec256Steal(const MatView& src, MatView* dst, int nr_threads) {
+  transpose_Steal(src, dst, nr_threads, [&](int64_t rb, int64_t cb, uint8_t*) {
+    transpose_Vec256_block(src, dst, rb, cb);
+  });
+}
+
+void transpose_Vec256BufStatic(const MatView& src, MatView* dst, int nr_threads) {
+  transpose_Static(src, dst, nr_threads, [&](int64_t rb, int64_t cb, uint8_t* buf) {
+    transpose_Vec256Buf_block(src, dst, rb, cb, buf);
+  });
+}
+
+void transpose_Vec256BufSteal(const MatView& src, MatView* dst, int nr_threads) {
+  transpose_Steal(src, dst, nr_threads, [&](int64_t rb, int64_t cb, uint8_t* buf) {
+    transpose_Vec256Buf_block(src, dst, rb, cb, buf);
+  });
+}
+
+/************************** Out-of-core ********************************/
+
+/* pread()/pwrite() of exactly size bytes, short transfers are continued */
+void pread_full(int fd, uint8_t* buf, int64_t size, int64_t offset) {
+  while (size > 0) {
+    ssize_t res = pread(fd, buf, size, offset);
+    ensure(res > 0);
+    buf += res;
+    size -= res;
+    offset += res;
+  }
+}
+
+void pwrite_full(int fd, const uint8_t* buf, int64_t size, int64_t offset) {
+  while (size > 0) {
+    ssize_t res = pwrite(fd, buf, size, offset);
+    ensure(res > 0);
+    buf += res;
+    size -= res;
+    offset += res;
+  }
+}
+
+struct FileStats {
+  int64_t tile_rows;
+  int64_t tile_cols;
+  bool direct;
+  double read_seconds;      // busy time of reads
+  double write_seconds;     // busy time of writes, final fsync() included
+  double transpose_seconds;
+  double seconds;           // wall time
+};
+
+/**
+ * Transpose rows x cols matrix in file src_path into cols x rows matrix in
+ * file dst_path, for matrices larger than memory. The matrix is cut into
+ * R x C tiles, processed in row-major order: a tile is read as R runs of C
+ * bytes, one run if C == cols, transposed with Vec256 and written as C runs
+ * of R bytes, one run if R == rows. Tiles are double-buffered, so tile i+1 is
+ * being read and tile i-1 written while tile i is transposed. Four tile
+ * buffers fit into memory_budget, and tiles are as square as the budget
+ * allows, which makes the shortest run as long as possible.
+ * direct requests O_DIRECT, which bypasses the page cache but needs every
+ * offset and size aligned to 4096, so it is used only if rows and cols are
+ * multiples of 4096, the budget fits 4096x4096 tiles and the file systems
+ * of both files support it; stats.direct tells whether it was.
+ */
+FileStats transpose_File(const std::string& src_path, const std::string& dst_path,
+                         int64_t rows, int64_t cols, int64_t memory_budget, bool direct) {
+  FileStats stats = {};
+  const int64_t tile_bytes = memory_budget/4;
+  stats.direct = direct && (rows % 4096 == 0) && (cols % 4096 == 0) && (tile_bytes >= 4096*4096);
+  const int64_t align = stats.direct ? 4096 : 64;
+  auto round_down = [&](int64_t x) { return std::max<int64_t>(x/align*align, align); };
+  // square tiles, unless the matrix is narrower than that in one dimension
+  const int64_t side = std::min(cols, round_down(std::sqrt(double(tile_bytes))));
+  const int64_t R = std::min(rows, round_down(tile_bytes/side));
+  const int64_t C = std::min(cols, round_down(tile_bytes/R));
+  stats.tile_rows = R;
+  stats.tile_cols = C;
+
+  // both files use the same mode: if either rejects O_DIRECT, neither gets it
+  auto open_files = [&](int* src_fd, int* dst_fd) {
+    const int flags = stats.direct ? O_DIRECT : 0;
+    *src_fd = open(src_path.c_str(), O_RDONLY | flags);
+    if (*src_fd < 0) {
+      *dst_fd = -1;
+      return;
+    }
+    *dst_fd = open(dst_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | flags, 0644);
+    if (*dst_fd < 0) {
+      int error = errno;
+      close(*src_fd);
+      *src_fd = -1;
+      errno = error;
+    }
+  };
+  int src_fd, dst_fd;
+  open_files(&src_fd, &dst_fd);
+  if (src_fd < 0 && errno == EINVAL && stats.direct) {
+    stats.direct = false;
+    open_files(&src_fd, &dst_fd);
+  }
+  ensure(src_fd >= 0 && dst_fd >= 0);
+  struct stat st;
+  ensure(fstat(src_fd, &st) == 0 && st.st_size == rows*cols);
+  ensure(ftruncate(dst_fd, rows*cols) == 0);
+
+  typedef std::unique_ptr<uint8_t[], decltype(&std::free)> Buffer;
+  auto allocate = [&]() {
+    uint8_t* data = static_cast<uint8_t*>(std::aligned_alloc(4096, (R*C + 4095) / 4096 * 4096));
+    ensure(data);
+    return Buffer(data, &std::free);
+  };
+  Buffer in[2] = {allocate(), allocate()};
+  Buffer out[2] = {allocate(), allocate()};
+
+  struct Tile {
+    int64_t r0, c0, h, w;
+  };
+  std::vector<Tile> tiles;
+  for (int64_t r0 = 0; r0 < rows; r0 += R) {
+    for (int64_t c0 = 0; c0 < cols; c0 += C) {
+      tiles.push_back({r0, c0, std::min(R, rows - r0), std::min(C, cols - c0)});
+    }
+  }
+
+  // tiles are stored compactly: h x w in in[], w x h in out[]
+  auto read_tile = [&](const Tile& tile, uint8_t* buf) {
+    if (tile.w == cols) {
+      pread_full(src_fd, buf, tile.h*cols, tile.r0*cols);
+      return;
+    }
+    for (int64_t r = 0; r < tile.h; r++) {
+      pread_full(src_fd, buf + r*tile.w, tile.w, (tile.r0 + r)*cols + tile.c0);
+    }
+  };
+  auto write_tile = [&](const Tile& tile, const uint8_t* buf) {
+    if (tile.h == rows) {
+      pwrite_full(dst_fd, buf, tile.w*rows, tile.c0*rows);
+      return;
+    }
+    for (int64_t c = 0; c < tile.w; c++) {
+      pwrite_full(dst_fd, buf + c*tile.h, tile.h, (tile.c0 + c)*rows + tile.r0);
+    }
+  };
+  auto timed = [](auto&& f) {
+    auto time1 = std::chrono::steady_clock::now();
+    f();
+    auto time2 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(time2 - time1).count();
+  };
+
+  auto time1 = std::chrono::steady_clock::now();
+  stats.read_seconds += timed([&]() { read_tile(tiles[0], in[0].get()); });
+  std::future<double> reading;
+  std::future<double> writing[2];
+  for (size_t i = 0; i < tiles.size(); i++) {
+    if (i+1 < tiles.size()) {
+      reading = std::async(std::launch::async, [&, i]() {
+        return timed([&]() { read_tile(tiles[i+1], in[(i+1)%2].get()); });
+      });
+    }
+    if (writing[i%2].valid()) {
+      stats.write_seconds += writing[i%2].get(); // out[i%2] still holds tile i-2
+    }
+    const Tile& tile = tiles[i];
+    stats.transpose_seconds += timed([&]() {
+      MatView src(in[i%2].get(), tile.h, tile.w, tile.w);
+      MatView dst(out[i%2].get(), tile.w, tile.h, tile.h);
+      transpose_Vec256(src, &dst);
+    });
+    writing[i%2] = std::async(std::launch::async, [&, i]() {
+      return timed([&]() { write_tile(tiles[i], out[i%2].get()); });
+    });
+    if (reading.valid()) {
+      stats.read_seconds += reading.get();
+    }
+  }
+  for (std::future<double>& w : writing) {
+    if (w.valid()) {
+      stats.write_seconds += w.get();
+    }
+  }
+  stats.write_seconds += timed([&]() { ensure(fsync(dst_fd) == 0); });
+  auto time2 = std::chrono::steady_clock::now();
+  stats.seconds = std::chrono::duration<double>(time2 - time1).count();
+
+  close(src_fd);
+  close(dst_fd);
+  return stats;
+}
+
+
+/**********************************************************/
+
+/**
+ * NUMA first touch for transpose_Static(): thread t zeroes block rows of dst
+ * that it is going to write and block columns of src that it is going to read,
+ * so that those pages are allocated on its node.
+ */
+void first_touch(Mat* src, Mat* dst, int nr_threads) {
+  const int64_t cols = src->cols();
+  const int64_t ncb = cols/64;
+  thread_pool().run(nr_threads, [&](int tid) {
+    Numa::Pin pin(numa, tid, nr_threads);
+    int64_t begin = 64*(ncb*tid/nr_threads);
+    int64_t end = (tid == nr_threads-1) ? cols : 64*(ncb*(tid+1)/nr_threads);
+    std::memset(dst->data() + begin*dst->ld(), 0, (end-begin)*dst->ld());
+    for (int64_t r = 0; r < src->rows(); r++) {
+      std::memset(src->data() + r*src->ld() + begin, 0, end-begin);
+    }
+  });
+}
+
+/**
+ * Per-node traffic of a NUMA-mode transpose_Static(). Bandwidth of a node is
+ * the bytes of its stripes over the time of its slowest thread, as measured
+ * in transpose_Static(). Shares of local reads and writes are an estimate
+ * from page placement, not measured traffic: placement is sampled on the
+ * first pair of matrices, one page lookup per 64-byte row of every block.
+ */
+void report_numa(const Mat& src, const Mat& dst, int nr_threads, int nr_mats) {
+  const int64_t nrb = src.rows()/64, ncb = src.cols()/64;
+  std::vector<int> src_nodes = numa.nodes_of_pages(src.data(), src.rows()*src.ld());
+  std::vector<int> dst_nodes = numa.nodes_of_pages(dst.data(), dst.rows()*dst.ld());
+  std::vector<int64_t> bytes(numa.nr_nodes(), 0);
+  std::vector<int64_t> local_reads(numa.nr_nodes(), 0);
+  std::vector<int64_t> local_writes(numa.nr_nodes(), 0);
+  std::vector<int> nr_node_threads(numa.nr_nodes(), 0);
+  for (int tid = 0; tid < nr_threads; tid++) {
+    int node = numa.node_of_thread(tid, nr_threads);
+    nr_node_threads[node]++;
+    for (int64_t rb = 0; rb < nrb; rb++) {
+      for (int64_t cb = ncb*tid/nr_threads; cb < ncb*(tid+1)/nr_threads; cb++) {
+        for (int64_t r = 0; r < 64; r++) {
+          const uint8_t* src_row = src.data() + (rb*64 + r)*src.ld() + cb*64;
+          const uint8_t* dst_row = dst.data() + (cb*64 + r)*dst.ld() + rb*64;
+          local_reads[node] += (Numa::node_of(src_nodes, src.data(), src_row) == node) ? 64 : 0;
+          local_writes[node] += (Numa::node_of(dst_nodes, dst.data(), dst_row) == node) ? 64 : 0;
+        }
+        bytes[node] += 64*64;
+      }
+    }
+  }
+  std::vector<double> node_seconds(numa.nr_nodes(), 0.0);
+  for (int tid = 0; tid < nr_threads; tid++) {
+    int node = numa.node_of_thread(tid, nr_threads);
+    node_seconds[node] = std::max(node_seconds[node], numa.thread_seconds(tid));
+  }
+  for (int node = 0; node < numa.nr_nodes(); node++) {
+    if (nr_node_threads[node] == 0) {
+      continue;
+    }
+    printf("# node %d: %d threads %8.3f GB/s, placement estimate: local reads %5.1f%%, local writes %5.1f%%\n",
+      node,
+      nr_node_threads[node],
+      2.0*bytes[node]*nr_mats/std::max(node_seconds[node], 1e-9)/1e9,
+      100.0*local_reads[node]/std::max<int64_t>(bytes[node], 1),
+      100.0*local_writes[node]/std::max<int64_t>(bytes[node], 1)
+    );
+  }
+}
+
+template<typename T>
+using Function = std::function<void(const MatViewT<T>&, MatViewT<T>*)>;
+
+/* algorithms for 2-, 4- and 8-byte elements */
+template<typename T>
+const std::unordered_map<std::string, Function<T>> functions = {
+  {"Naive",   transpose_Naive<T>},
+  {"Reverse", transpose_Reverse<T>},
+  {"Blocks",  transpose_Blocks<T>},
+  {"Vec256",  transpose_Vec256Wide<T>}
+};
+
+template<>
+const std::unordered_map<std::string, Function<uint8_t>> functions<uint8_t> = {
+  {"Naive",      transpose_Naive<uint8_t>},
+  {"Reverse",    transpose_Reverse<uint8_t>},
+  {"Blocks",     transpose_Blocks<uint8_t>},
+  {"BlocksPrf",  transpose_BlocksPrf},
+  {"Vec32",      transpose_Vec32},
+  {"Vec64",      transpose_Vec64},
+  {"Vec256",     transpose_Vec256},
+  {"Vec256Buf",  transpose_Vec256Buf},
+  {"Vec256Vbmi", transpose_Vec256Vbmi},
+  {"Vec512",     transpose_Vec512},
+  {"Vec512Buf",  transpose_Vec512Buf},
+  {"Recursive",  transpose_Recursive},
+  {"Tuned",      transpose_Tuned}
+};
+
+const std::unordered_map<std::string, std::function<void(const MatView&, MatView*, int)>> parallel_functions = {
+  {"Vec256Static",    transpose_Vec256Static},
+  {"Vec256Steal",     transpose_Vec256Steal},
+  {"Vec256BufStatic", transpose_Vec256BufStatic},
+  {"Vec256BufSteal",  transpose_Vec256BufSteal}
+};
+
+/* algorithms transposing a square matrix in place */
+const std::unordered_map<std::string, std::function<void(MatView*)>> in_place_functions = {
+  {"InPlace", transpose_InPlace}
+};
+
+
+/**
+ * Note on the algorithm that actually ran if algo fell back to another one:
+ * the Buf variants need rows of dst aligned for streaming stores, Vec512 and
+ * Vec256Vbmi need AVX-512 VBMI. Empty if algo ran as itself. Results with a
+ * note must not be compared as results of algo, see table.py.
+ */
+std::string fallback_note(const std::string& algo, const MatView& dst) {
+  auto aligned = [&](int64_t alignment) {
+    return dst.ld() % alignment == 0 && uintptr_t(dst.data()) % alignment == 0;
+  };
+  auto unaligned = [](int64_t alignment) {
+    return "rows of dst are not " + std::to_string(alignment) + "-byte aligned for streaming stores";
+  };
+  const bool vbmi = (ISA >= Isa::Avx512);
+  if ((algo == "Vec512" || algo == "Vec256Vbmi") && !vbmi) {
+    return "ran as Vec256: no AVX-512 VBMI";
+  }
+  if (algo == "Vec512Buf" && (!vbmi || !aligned(64))) {
+    if (!aligned(stream_alignment())) {
+      return "ran as Vec256: " + unaligned(stream_alignment());
+    }
+    return "ran as Vec256Buf: " + (!vbmi ? std::string("no AVX-512 VBMI") : unaligned(64));
+  }
+  for (const char* suffix : {"", "Static", "Steal"}) {
+    if (algo == std::string("Vec256Buf") + suffix && !aligned(stream_alignment())) {
+      return std::string("ran as Vec256") + suffix + ": " + unaligned(stream_alignment());
+    }
+  }
+  return "";
+}
+
+template<typename T>
+void run(int64_t rows, int64_t cols, const std::string& algo, const std::string& spec, Padding padding, int64_t volume, bool markers, bool verify, int nr_threads) {
+  Function<T> function;
+  std::function<void(MatViewT<T>*)> in_place_function; // transposes src, there are no dsts
+  if constexpr (std::is_same<T, uint8_t>::value) {
+    ensure(!numa.enabled() || parallel_functions.count(algo));
+    if (parallel_functions.count(algo)) {
+      auto parallel_function = parallel_functions.at(algo);
+      function = [=](const MatView& src, MatView* dst) { parallel_function(src, dst, nr_threads); };
+    }
+    if (in_place_functions.count(algo)) {
+      ensure(nr_threads == 1);
+      in_place_function = in_place_functions.at(algo);
+    }
+  }
+  if (!function && !in_place_function) {
+    ensure(nr_threads == 1 && !numa.enabled());
+    function = functions<T>.at(algo);
+  }
+
+  int nr_mats = std::max<int>(volume/std::max<int64_t>(rows*cols*sizeof(T), 1), 1);
+  
+  std::vector<std::unique_ptr<MatT<T>>> srcs;
+  std::vector<std::unique_ptr<MatT<T>>> dsts;
+  for (int i = 0; i < nr_mats; i++) {
+    srcs.push_back(std::make_unique<MatT<T>>(rows, cols, padding));
+    if (!in_place_function) {
+      dsts.push_back(std::make_unique<MatT<T>>(cols, rows, padding));
+    }
+  }
+
+  // in NUMA mode pages are placed before any other access, fill_random() included
+  if constexpr (std::is_same<T, uint8_t>::value) {
+    if (numa.enabled()) {
+      for (int i = 0; i < nr_mats; i++) {
+        first_touch(srcs[i].get(), dsts[i].get(), nr_threads);
+      }
+    }
+  }
+
+  for (int i = 0; i < nr_mats; i++) {
+    fill_random(srcs[i].get());
+  }
+
+  for (auto& dst : dsts) {
+    explicit_bzero(dst->data(), dst->rows()*dst->ld()*sizeof(T));
+  }
+
+  // in-place results are checked against a copy of the first matrix only,
+  // copies of all of them would take the memory that in-place saves
+  std::unique_ptr<MatT<T>> original;
+  if (in_place_function && verify) {
+    original = std::make_unique<MatT<T>>(rows, cols, padding);
+    std::memcpy(original->data(), srcs[0]->data(), rows*original->ld()*sizeof(T));
+  }
+  
+  if (markers) {
+    printf("PERF-BEGIN\n");
+    fflush(stdout);
+  }
+  if (numa.enabled()) {
+    numa.reset_thread_seconds(nr_threads);
+  }
+  auto time1 = std::chrono::steady_clock::now();
+  int64_t ts1 = rdtscp();
+  for (int i = 0; i < nr_mats; i++) {
+    if (in_place_function) {
+      in_place_function(srcs[i].get());
+    } else {
+      function(*srcs[i], dsts[i].get());
+    }
+  }
+  int64_t ts2 = rdtscp();
+  auto time2 = std::chrono::steady_clock::now();
+  if (markers) {
+    printf("PERF-END\n");
+    fflush(stdout);
+  }
+
+  if (verify) {
+    if (in_place_function) {
+      check_transpose(*original, *srcs[0]);
+    } else {
+      for (int i = 0; i < nr_mats; i++) {
+        check_transpose(*srcs[i], *dsts[i]);
+      }
+    }
+  }
+
+  // every element is read once and written once
+  double seconds = std::chrono::duration<double>(time2 - time1).count();
+  std::string shape = std::to_string(rows);
+  if (rows != cols) {
+    shape += "x" + std::to_string(cols);
+  }
+  printf("%15s %7s %10.6f %d %3d %8.3f\n",
+    spec.c_str(),
+    shape.c_str(),
+    double(ts2-ts1)/nr_mats/rows/cols, // cycles per element
+    nr_mats,
+    nr_threads,
+    2.0*rows*cols*sizeof(T)*nr_mats/seconds/1e9 // GB/s
+  );
+  if constexpr (std::is_same<T, uint8_t>::value) {
+    std::string note = dsts.empty() ? "" : fallback_note(algo, *dsts[0]);
+    if (!note.empty()) {
+      printf("# %s\n", note.c_str());
+    }
+    if (numa.enabled()) {
+      report_numa(*srcs[0], *dsts[0], nr_threads, nr_mats);
+    }
+  }
+  fflush(stdout);
+}
+
+
+/* square "n" or "<rows>x<cols>" */
+void parse_shape(const std::string& shape, int64_t* rows, int64_t* cols) {
+  size_t x = shape.find('x');
+  *rows = std::stoll(shape.substr(0, x));
+  *cols = (x == std::string::npos) ? *rows : std::stoll(shape.substr(x + 1));
+  ensure(*rows > 0 && *cols > 0);
+}
+
+void create_random_file(const std::string& path, int64_t size) {
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  ensure(fd >= 0);
+  std::vector<uint64_t> chunk(8*1024*1024);
+  const int64_t chunk_size = chunk.size()*sizeof(uint64_t);
+  for (int64_t off = 0; off < size; off += chunk_size) {
+    for (uint64_t& word : chunk) {
+      word = xorshift64();
+    }
+    pwrite_full(fd, (const uint8_t*)chunk.data(), std::min(chunk_size, size - off), off);
+  }
+  ensure(fsync(fd) == 0);
+  close(fd);
+}
+
+/* whole matrices if they fit into 256 MiB, random samples otherwise */
+void check_transpose_files(const std::string& src_path, const std::string& dst_path, int64_t rows, int64_t cols) {
+  int src_fd = open(src_path.c_str(), O_RDONLY);
+  int dst_fd = open(dst_path.c_str(), O_RDONLY);
+  ensure(src_fd >= 0 && dst_fd >= 0);
+  if (rows*cols <= (1 << 28)) {
+    Mat src(rows, cols);
+    Mat dst(cols, rows);
+    pread_full(src_fd, src.data(), rows*cols, 0);
+    pread_full(dst_fd, dst.data(), rows*cols, 0);
+    check_transpose(src, dst);
+  } else {
+    for (int i = 0; i < (1 << 16); i++) {
+      int64_t r = xorshift64() % rows;
+      int64_t c = xorshift64() % cols;
+      uint8_t a, b;
+      pread_full(src_fd, &a, 1, r*cols + c);
+      pread_full(dst_fd, &b, 1, c*rows + r);
+      ensure(a == b);
+    }
+  }
+  close(src_fd);
+  close(dst_fd);
+}
+
+/**
+ * Out-of-core mode, see transpose_File(). src is filled with random bytes
+ * unless it already holds rows*cols of them, and its pages are dropped from
+ * the page cache, so that reads come from the disk.
+ */
+int main_file(int argc, char* argv[]) {
+  if (argc != 8) {
+    printf("Usage: %s file <rows>x<cols> <src> <dst> <memory budget> <direct> <verify>\n", argv[0]);
+    return 1;
+  }
+  int64_t rows, cols;
+  parse_shape(argv[2], &rows, &cols);
+  std::string src_path(argv[3]);
+  std::string dst_path(argv[4]);
+  int64_t memory_budget = std::stoll(argv[5]);
+  int direct = atoi(argv[6]);
+  int verify = atoi(argv[7]);
+
+  struct stat st;
+  if (stat(src_path.c_str(), &st) != 0 || st.st_size != rows*cols) {
+    create_random_file(src_path, rows*cols);
+  }
+  int fd = open(src_path.c_str(), O_RDONLY);
+  ensure(fd >= 0);
+  ensure(posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0);
+  close(fd);
+
+  int64_t ts1 = rdtscp();
+  FileStats stats = transpose_File(src_path, dst_path, rows, cols, memory_budget, direct);
+  int64_t ts2 = rdtscp();
+
+  if (verify) {
+    check_transpose_files(src_path, dst_path, rows, cols);
+  }
+
+  printf("%15s %7s %10.6f %d %3d %8.3f\n",
+    "File",
+    argv[2],
+    double(ts2-ts1)/rows/cols, // cycles per element
+    1,
+    1,
+    2.0*rows*cols/stats.seconds/1e9 // GB/s
+  );
+  printf("# tile %ldx%ld, direct %d, read %.3f GB/s, write %.3f GB/s, transpose %.3f s of %.3f s\n",
+    stats.tile_rows,
+    stats.tile_cols,
+    stats.direct,
+    rows*cols/stats.read_seconds/1e9,
+    rows*cols/stats.write_seconds/1e9,
+    stats.transpose_seconds,
+    stats.seconds
+  );
+  fflush(stdout);
+  return 0;
+}
+
+
+/**
+ * Autotuning mode: every combination of TuneParams on a grid is timed on
+ * volume bytes of rows x cols matrices, best of 3 runs, and the fastest one
+ * is stored in wisdom for the current instruction set and shape.
+ */
+int main_tune(int argc, char* argv[]) {
+  if (argc != 4) {
+    printf("Usage: %s tune <n>|<rows>x<cols> <volume>\n", argv[0]);
+    return 1;
+  }
+  int64_t rows, cols;
+  parse_shape(argv[2], &rows, &cols);
+  int64_t volume = std::stoll(argv[3]);
+
+  int nr_mats = std::max<int>(volume/(rows*cols), 1);
+  std::vector<std::unique_ptr<Mat>> srcs;
+  std::vector<std::unique_ptr<Mat>> dsts;
+  for (int i = 0; i < nr_mats; i++) {
+    srcs.push_back(std::make_unique<Mat>(rows, cols));
+    dsts.push_back(std::make_unique<Mat>(cols, rows));
+    fill_random(srcs[i].get());
+    explicit_bzero(dsts[i]->data(), rows*cols);
+  }
+
+  // SWAR kernel left out: SSE2 is part of x86-64 and always faster
+  std::vector<TuneParams> grid;
+  for (Isa kernel = Isa::Sse; kernel <= ISA; kernel = Isa(int(kernel) + 1)) {
+    for (int64_t block : {64, 128, 256}) {
+      for (int prefetch_distance : {0, 1, 2, 4}) {
+        for (bool prefetch_nta : {true, false}) {
+          if (prefetch_distance == 0 && !prefetch_nta) {
+            continue; // no prefetch, no hint
+          }
+          for (bool stream : {false, true}) {
+            grid.push_back({block, prefetch_distance, prefetch_nta, stream, kernel});
+          }
+        }
+      }
+    }
+  }
+
+  TuneParams best_params = grid[0];
+  double best_cpe = std::numeric_limits<double>::infinity();
+  double best_seconds = 0;
+  for (const TuneParams& params : grid) {
+    double cpe = std::numeric_limits<double>::infinity();
+    double seconds = 0;
+    for (int rep = 0; rep < 3; rep++) {
+      auto time1 = std::chrono::steady_clock::now();
+      int64_t ts1 = rdtscp();
+      for (int i = 0; i < nr_mats; i++) {
+        transpose_Tunable(*srcs[i], dsts[i].get(), params);
+      }
+      int64_t ts2 = rdtscp();
+      auto time2 = std::chrono::steady_clock::now();
+      if (double(ts2-ts1)/nr_mats/rows/cols < cpe) {
+        cpe = double(ts2-ts1)/nr_mats/rows/cols;
+        seconds = std::chrono::duration<double>(time2 - time1).count();
+      }
+    }
+    printf("# kernel %-6s block %3ld prefetch %d %-3s %-7s %10.6f\n",
+      isa_name(params.kernel),
+      params.block,
+      params.prefetch_distance,
+      params.prefetch_nta ? "nta" : "t0",
+      params.stream ? "stream" : "regular",
+      cpe
+    );
+    if (cpe < best_cpe) {
+      best_params = params;
+      best_cpe = cpe;
+      best_seconds = seconds;
+    }
+  }
+  check_transpose(*srcs[0], *dsts[0]);
+
+  Wisdom& w = wisdom();
+  w.put(ISA, rows, cols, best_params, best_cpe);
+  w.save(Wisdom::path());
+
+  printf("%15s %7s %10.6f %d %3d %8.3f\n",
+    "Tuned",
+    argv[2],
+    best_cpe,
+    nr_mats,
+    1,
+    2.0*rows*cols*nr_mats/best_seconds/1e9 // GB/s
+  );
+  printf("# best: kernel %s block %ld prefetch %d %s %s, saved to %s\n",
+    isa_name(best_params.kernel),
+    best_params.block,
+    best_params.prefetch_distance,
+    best_params.prefetch_nta ? "nta" : "t0",
+    best_params.stream ? "stream" : "regular",
+    Wisdom::path().c_str()
+  );
+  fflush(stdout);
+  return 0;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc >= 2 && std::string(argv[1]) == "file") {
+    return main_file(argc, argv);
+  }
+  if (argc >= 2 && std::string(argv[1]) == "tune") {
+    return main_tune(argc, argv);
+  }
+  if (argc < 6 || argc > 8) {
+    printf("Usage: %s <n>|<rows>x<cols> <algorithm>[:u16|u32|u64][:padded] <volume> <markers> <verify> [<threads>[,<threads>...] [<numa>]]\n", argv[0]);
+    printf("       %s file <rows>x<cols> <src> <dst> <memory budget> <direct> <verify>\n", argv[0]);
+    printf("       %s tune <n>|<rows>x<cols> <volume>\n", argv[0]);
+    printf("Vector kernels: %s (TRANSPOSE_ISA=scalar|sse|avx2|avx512 to lower)\n", isa_name(ISA));
+    return 1;
+  }
+  int64_t rows, cols;
+  parse_shape(argv[1], &rows, &cols);
+  // algorithm name, optionally followed by element type, bytes by default,
+  // and by "padded" for rows padded by padded_ld()
+  std::string spec(argv[2]);
+  size_t colon = spec.find(':');
+  std::string algorithm = spec.substr(0, colon);
+  std::string type = "u8";
+  Padding padding = Padding::None;
+  while (colon != std::string::npos) {
+    size_t next = spec.find(':', colon + 1);
+    std::string option = spec.substr(colon + 1, next - colon - 1);
+    if (option == "padded") {
+      padding = Padding::Cache;
+    } else {
+      type = option;
+    }
+    colon = next;
+  }
+  int64_t volume = std::stoll(argv[3]);
+  int markers = atoi(argv[4]);
+  int verify = atoi(argv[5]);
+
+  // comma-separated list of thread counts, one run per count
+  std::vector<int> thread_counts;
+  std::string threads = (argc >= 7) ? argv[6] : "1";
+  for (size_t pos = 0; pos <= threads.size(); ) {
+    size_t comma = std::min(threads.find(',', pos), threads.size());
+    thread_counts.push_back(std::stoi(threads.substr(pos, comma - pos)));
+    ensure(thread_counts.back() >= 1);
+    pos = comma + 1;
+  }
+
+  if ((argc == 8) && atoi(argv[7])) {
+    numa.enable();
+  }
+
+  for (int nr_threads : thread_counts) {
+    if (type == "u8") {
+      run<uint8_t>(rows, cols, algorithm, spec, padding, volume, markers, verify, nr_threads);
+    } else if (type == "u16") {
+      run<uint16_t>(rows, cols, algorithm, spec, padding, volume, markers, verify, nr_threads);
+    } else if (type == "u32") {
+      run<uint32_t>(rows, cols, algorithm, spec, padding, volume, markers, verify, nr_threads);
+    } else if (type == "u64") {
+      run<uint64_t>(rows, cols, algorithm, spec, padding, volume, markers, verify, nr_threads);
+    } else {
+      throw std::runtime_error("unknown element type " + type);
+    }
+  }
 
   return 0;
 }
@@ -1,101 +1,101 @@
-void transpose_Vec256_kernel(const uint8_t* src_origin, uint8_t* dst_origin, const uint8_t* prf_origin, int src_stride, int dst_stride) {
+void transpose_Vec256_kernel(const uint8_t* src_origin, uint8_t* dst_origin, const uint8_t* prf_origin, int64_t src_stride, int64_t dst_stride) {
   __m256i shm_1 = SHUFFLE_MASK[0];
   __m256i blm_1 = BLENDV_MASK[0];
-  __m256i rnd_0_0 = *(const __m256i*)(src_origin + 0*src_stride);
-  __m256i rnd_0_1 = *(const __m256i*)(src_origin + 1*src_stride);
+  __m256i rnd_0_0 = _mm256_loadu_si256((const __m256i*)(src_origin + 0*src_stride));
+  __m256i rnd_0_1 = _mm256_loadu_si256((const __m256i*)(src_origin + 1*src_stride));
   __m256i shf_1_0 = _mm256_shuffle_epi8(rnd_0_0, shm_1);
   __m256i shf_1_1 = _mm256_shuffle_epi8(rnd_0_1, shm_1);
   __m256i rnd_1_0 = _mm256_blendv_epi8(rnd_0_0, shf_1_1, blm_1);
   __m256i rnd_1_1 = _mm256_blendv_epi8(shf_1_0, rnd_0_1, blm_1);
-  __m256i rnd_0_2 = *(const __m256i*)(src_origin + 2*src_stride);
-  __m256i rnd_0_3 = *(const __m256i*)(src_origin + 3*src_stride);
+  __m256i rnd_0_2 = _mm256_loadu_si256((const __m256i*)(src_origin + 2*src_stride));
+  __m256i rnd_0_3 = _mm256_loadu_si256((const __m256i*)(src_origin + 3*src_stride));
   __m256i shf_1_2 = _mm256_shuffle_epi8(rnd_0_2, shm_1);
   __m256i shf_1_3 = _mm256_shuffle_epi8(rnd_0_3, shm_1);
   __m256i rnd_1_2 = _mm256_blendv_epi8(rnd_0_2, shf_1_3, blm_1);
   __m256i rnd_1_3 = _mm256_blendv_epi8(shf_1_2, rnd_0_3, blm_1);
-  __m256i rnd_0_4 = *(const __m256i*)(src_origin + 4*src_stride);
-  __m256i rnd_0_5 = *(const __m256i*)(src_origin + 5*src_stride);
+  __m256i rnd_0_4 = _mm256_loadu_si256((const __m256i*)(src_origin + 4*src_stride));
+  __m256i rnd_0_5 = _mm256_loadu_si256((const __m256i*)(src_origin + 5*src_stride));
   __m256i shf_1_4 = _mm256_shuffle_epi8(rnd_0_4, shm_1);
   __m256i shf_1_5 = _mm256_shuffle_epi8(rnd_0_5, shm_1);
   __m256i rnd_1_4 = _mm256_blendv_epi8(rnd_0_4, shf_1_5, blm_1);
   __m256i rnd_1_5 = _mm256_blendv_epi8(shf_1_4, rnd_0_5, blm_1);
-  __m256i rnd_0_6 = *(const __m256i*)(src_origin + 6*src_stride);
-  __m256i rnd_0_7 = *(const __m256i*)(src_origin + 7*src_stride);
+  __m256i rnd_0_6 = _mm256_loadu_si256((const __m256i*)(src_origin + 6*src_stride));
+  __m256i rnd_0_7 = _mm256_loadu_si256((const __m256i*)(src_origin + 7*src_stride));
   __m256i shf_1_6 = _mm256_shuffle_epi8(rnd_0_6, shm_1);
   __m256i shf_1_7 = _mm256_shuffle_epi8(rnd_0_7, shm_1);
   _mm_prefetch(prf_origin+0*src_stride, _MM_HINT_NTA);
   __m256i rnd_1_6 = _mm256_blendv_epi8(rnd_0_6, shf_1_7, blm_1);
   __m256i rnd_1_7 = _mm256_blendv_epi8(shf_1_6, rnd_0_7, blm_1);
-  __m256i rnd_0_8 = *(const __m256i*)(src_origin + 8*src_stride);
-  __m256i rnd_0_9 = *(const __m256i*)(src_origin + 9*src_stride);
+  __m256i rnd_0_8 = _mm256_loadu_si256((const __m256i*)(src_origin + 8*src_stride));
+  __m256i rnd_0_9 = _mm256_loadu_si256((const __m256i*)(src_origin + 9*src_stride));
   __m256i shf_1_8 = _mm256_shuffle_epi8(rnd_0_8, shm_1);
   __m256i shf_1_9 = _mm256_shuffle_epi8(rnd_0_9, shm_1);
   __m256i rnd_1_8 = _mm256_blendv_epi8(rnd_0_8, shf_1_9, blm_1);
   __m256i rnd_1_9 = _mm256_blendv_epi8(shf_1_8, rnd_0_9, blm_1);
-  __m256i rnd_0_10 = *(const __m256i*)(src_origin + 10*src_stride);
-  __m256i rnd_0_11 = *(const __m256i*)(src_origin + 11*src_stride);
+  __m256i rnd_0_10 = _mm256_loadu_si256((const __m256i*)(src_origin + 10*src_stride));
+  __m256i rnd_0_11 = _mm256_loadu_si256((const __m256i*)(src_origin + 11*src_stride));
   __m256i shf_1_10 = _mm256_shuffle_epi8(rnd_0_10, shm_1);
   __m256i shf_1_11 = _mm256_shuffle_epi8(rnd_0_11, shm_1);
   __m256i rnd_1_10 = _mm256_blendv_epi8(rnd_0_10, shf_1_11, blm_1);
   __m256i rnd_1_11 = _mm256_blendv_epi8(shf_1_10, rnd_0_11, blm_1);
-  __m256i rnd_0_12 = *(const __m256i*)(src_origin + 12*src_stride);
-  __m256i rnd_0_13 = *(const __m256i*)(src_origin + 13*src_stride);
+  __m256i rnd_0_12 = _mm256_loadu_si256((const __m256i*)(src_origin + 12*src_stride));
+  __m256i rnd_0_13 = _mm256_loadu_si256((const __m256i*)(src_origin + 13*src_stride));
   __m256i shf_1_12 = _mm256_shuffle_epi8(rnd_0_12, shm_1);
   __m256i shf_1_13 = _mm256_shuffle_epi8(rnd_0_13, shm_1);
   __m256i rnd_1_12 = _mm256_blendv_epi8(rnd_0_12, shf_1_13, blm_1);
   __m256i rnd_1_13 = _mm256_blendv_epi8(shf_1_12, rnd_0_13, blm_1);
-  __m256i rnd_0_14 = *(const __m256i*)(src_origin + 14*src_stride);
-  __m256i rnd_0_15 = *(const __m256i*)(src_origin + 15*src_stride);
+  __m256i rnd_0_14 = _mm256_loadu_si256((const __m256i*)(src_origin + 14*src_stride));
+  __m256i rnd_0_15 = _mm256_loadu_si256((const __m256i*)(src_origin + 15*src_stride));
   __m256i shf_1_14 = _mm256_shuffle_epi8(rnd_0_14, shm_1);
   __m256i shf_1_15 = _mm256_shuffle_epi8(rnd_0_15, shm_1);
   _mm_prefetch(prf_origin+1*src_stride, _MM_HINT_NTA);
   __m256i rnd_1_14 = _mm256_blendv_epi8(rnd_0_14, shf_1_15, blm_1);
   __m256i rnd_1_15 = _mm256_blendv_epi8(shf_1_14, rnd_0_15, blm_1);
-  __m256i rnd_0_16 = *(const __m256i*)(src_origin + 16*src_stride);
-  __m256i rnd_0_17 = *(const __m256i*)(src_origin + 17*src_stride);
+  __m256i rnd_0_16 = _mm256_loadu_si256((const __m256i*)(src_origin + 16*src_stride));
+  __m256i rnd_0_17 = _mm256_loadu_si256((const __m256i*)(src_origin + 17*src_stride));
   __m256i shf_1_16 = _mm256_shuffle_epi8(rnd_0_16, shm_1);
   __m256i shf_1_17 = _mm256_shuffle_epi8(rnd_0_17, shm_1);
   __m256i rnd_1_16 = _mm256_blendv_epi8(rnd_0_16, shf_1_17, blm_1);
   __m256i rnd_1_17 = _mm256_blendv_epi8(shf_1_16, rnd_0_17, blm_1);
-  __m256i rnd_0_18 = *(const __m256i*)(src_origin + 18*src_stride);
-  __m256i rnd_0_19 = *(const __m256i*)(src_origin + 19*src_stride);
+  __m256i rnd_0_18 = _mm256_loadu_si256((const __m256i*)(src_origin + 18*src_stride));
+  __m256i rnd_0_19 = _mm256_loadu_si256((const __m256i*)(src_origin + 19*src_stride));
   __m256i shf_1_18 = _mm256_shuffle_epi8(rnd_0_18, shm_1);
   __m256i shf_1_19 = _mm256_shuffle_epi8(rnd_0_19, shm_1);
   __m256i rnd_1_18 = _mm256_blendv_epi8(rnd_0_18, shf_1_19, blm_1);
   __m256i rnd_1_19 = _mm256_blendv_epi8(shf_1_18, rnd_0_19, blm_1);
-  __m256i rnd_0_20 = *(const __m256i*)(src_origin + 20*src_stride);
-  __m256i rnd_0_21 = *(const __m256i*)(src_origin + 21*src_stride);
+  __m256i rnd_0_20 = _mm256_loadu_si256((const __m256i*)(src_origin + 20*src_stride));
+  __m256i rnd_0_21 = _mm256_loadu_si256((const __m256i*)(src_origin + 21*src_stride));
   __m256i shf_1_20 = _mm256_shuffle_epi8(rnd_0_20, shm_1);
   __m256i shf_1_21 = _mm256_shuffle_epi8(rnd_0_21, shm_1);
   __m256i rnd_1_20 = _mm256_blendv_epi8(rnd_0_20, shf_1_21, blm_1);
   __m256i rnd_1_21 = _mm256_blendv_epi8(shf_1_20, rnd_0_21, blm_1);
-  __m256i rnd_0_22 = *(const __m256i*)(src_origin + 22*src_stride);
-  __m256i rnd_0_23 = *(const __m256i*)(src_origin + 23*src_stride);
+  __m256i rnd_0_22 = _mm256_loadu_si256((const __m256i*)(src_origin + 22*src_stride));
+  __m256i rnd_0_23 = _mm256_loadu_si256((const __m256i*)(src_origin + 23*src_stride));
   __m256i shf_1_22 = _mm256_shuffle_epi8(rnd_0_22, shm_1);
   __m256i shf_1_23 = _mm256_shuffle_epi8(rnd_0_23, shm_1);
   _mm_prefetch(prf_origin+2*src_stride, _MM_HINT_NTA);
   __m256i rnd_1_22 = _mm256_blendv_epi8(rnd_0_22, shf_1_23, blm_1);
   __m256i rnd_1_23 = _mm256_blendv_epi8(shf_1_22, rnd_0_23, blm_1);
-  __m256i rnd_0_24 = *(const __m256i*)(src_origin + 24*src_stride);
-  __m256i rnd_0_25 = *(const __m256i*)(src_origin + 25*src_stride);
+  __m256i rnd_0_24 = _mm256_loadu_si256((const __m256i*)(src_origin + 24*src_stride));
+  __m256i rnd_0_25 = _mm256_loadu_si256((const __m256i*)(src_origin + 25*src_stride));
   __m256i shf_1_24 = _mm256_shuffle_epi8(rnd_0_24, shm_1);
   __m256i shf_1_25 = _mm256_shuffle_epi8(rnd_0_25, shm_1);
   __m256i rnd_1_24 = _mm256_blendv_epi8(rnd_0_24, shf_1_25, blm_1);
   __m256i rnd_1_25 = _mm256_blendv_epi8(shf_1_24, rnd_0_25, blm_1);
-  __m256i rnd_0_26 = *(const __m256i*)(src_origin + 26*src_stride);
-  __m256i rnd_0_27 = *(const __m256i*)(src_origin + 27*src_stride);
+  __m256i rnd_0_26 = _mm256_loadu_si256((const __m256i*)(src_origin + 26*src_stride));
+  __m256i rnd_0_27 = _mm256_loadu_si256((const __m256i*)(src_origin + 27*src_stride));
   __m256i shf_1_26 = _mm256_shuffle_epi8(rnd_0_26, shm_1);
   __m256i shf_1_27 = _mm256_shuffle_epi8(rnd_0_27, shm_1);
   __m256i rnd_1_26 = _mm256_blendv_epi8(rnd_0_26, shf_1_27, blm_1);
   __m256i rnd_1_27 = _mm256_blendv_epi8(shf_1_26, rnd_0_27, blm_1);
-  __m256i rnd_0_28 = *(const __m256i*)(src_origin + 28*src_stride);
-  __m256i rnd_0_29 = *(const __m256i*)(src_origin + 29*src_stride);
+  __m256i rnd_0_28 = _mm256_loadu_si256((const __m256i*)(src_origin + 28*src_stride));
+  __m256i rnd_0_29 = _mm256_loadu_si256((const __m256i*)(src_origin + 29*src_stride));
   __m256i shf_1_28 = _mm256_shuffle_epi8(rnd_0_28, shm_1);
   __m256i shf_1_29 = _mm256_shuffle_epi8(rnd_0_29, shm_1);
   __m256i rnd_1_28 = _mm256_blendv_epi8(rnd_0_28, shf_1_29, blm_1);
   __m256i rnd_1_29 = _mm256_blendv_epi8(shf_1_28, rnd_0_29, blm_1);
-  __m256i rnd_0_30 = *(const __m256i*)(src_origin + 30*src_stride);
-  __m256i rnd_0_31 = *(const __m256i*)(src_origin + 31*src_stride);
+  __m256i rnd_0_30 = _mm256_loadu_si256((const __m256i*)(src_origin + 30*src_stride));
+  __m256i rnd_0_31 = _mm256_loadu_si256((const __m256i*)(src_origin + 31*src_stride));
   __m256i shf_1_30 = _mm256_shuffle_epi8(rnd_0_30, shm_1);
   __m256i shf_1_31 = _mm256_shuffle_epi8(rnd_0_31, shm_1);
   _mm_prefetch(prf_origin+3*src_stride, _MM_HINT_NTA);
@@ -312,100 +312,100 @@ void transpose_Vec256_kernel(const uint8_t* src_origin, uint8_t* dst_origin, con
   __m256i shf_5_16 = _mm256_permute2x128_si256(rnd_4_16, rnd_4_16, 0x01);
   __m256i rnd_5_0 = _mm256_blendv_epi8(rnd_4_0, shf_5_16, blm_5);
   __m256i rnd_5_16 = _mm256_blendv_epi8(shf_5_0, rnd_4_16, blm_5);
-  *(__m256i*)(dst_origin + 0*dst_stride) = rnd_5_0;
-  *(__m256i*)(dst_origin + 16*dst_stride) = rnd_5_16;
+  _mm256_storeu_si256((__m256i*)(dst_origin + 0*dst_stride), rnd_5_0);
+  _mm256_storeu_si256((__m256i*)(dst_origin + 16*dst_stride), rnd_5_16);
   __m256i shf_5_1 = _mm256_permute2x128_si256(rnd_4_1, rnd_4_1, 0x01);
   __m256i shf_5_17 = _mm256_permute2x128_si256(rnd_4_17, rnd_4_17, 0x01);
   __m256i rnd_5_1 = _mm256_blendv_epi8(rnd_4_1, shf_5_17, blm_5);
   __m256i rnd_5_17 = _mm256_blendv_epi8(shf_5_1, rnd_4_17, blm_5);
-  *(__m256i*)(dst_origin + 1*dst_stride) = rnd_5_1;
-  *(__m256i*)(dst_origin + 17*dst_stride) = rnd_5_17;
+  _mm256_storeu_si256((__m256i*)(dst_origin + 1*dst_stride), rnd_5_1);
+  _mm256_storeu_si256((__m256i*)(dst_origin + 17*dst_stride), rnd_5_17);
   __m256i shf_5_2 = _mm256_permute2x128_si256(rnd_4_2, rnd_4_2, 0x01);
   __m256i shf_5_18 = _mm256_permute2x128_si256(rnd_4_18, rnd_4_18, 0x01);
   __m256i rnd_5_2 = _mm256_blendv_epi8(rnd_4_2, shf_5_18, blm_5);
   _mm_prefetch(prf_origin+12*src_stride, _MM_HINT_NTA);
   __m256i rnd_5_18 = _mm256_blendv_epi8(shf_5_2, rnd_4_18, blm_5);
-  *(__m256i*)(dst_origin + 2*dst_stride) = rnd_5_2;
-  *(__m256i*)(dst_origin + 18*dst_stride) = rnd_5_18;
+  _mm256_storeu_si256((__m256i*)(dst_origin + 2*dst_stride), rnd_5_2);
+  _mm256_storeu_si256((__m256i*)(dst_origin + 18*dst_stride), rnd_5_18);
   __m256i shf_5_3 = _mm256_permute2x128_si256(rnd_4_3, rnd_4_3, 0x01);
   __m256i shf_5_19 = _mm256_permute2x128_si256(rnd_4_19, rnd_4_19, 0x01);
   __m256i rnd_5_3 = _mm256_blendv_epi8(rnd_4_3, shf_5_19, blm_5);
   __m256i rnd_5_19 = _mm256_blendv_epi8(shf_5_3, rnd_4_19, blm_5);
-  *(__m256i*)(dst_origin + 3*dst_stride) = rnd_5_3;
-  *(__m256i*)(dst_origin + 19*dst_stride) = rnd_5_19;
+  _mm256_storeu_si256((__m256i*)(dst_origin + 3*dst_stride), rnd_5_3);
+  _mm256_storeu_si256((__m256i*)(dst_origin + 19*dst_stride), rnd_5_19);
   __m256i shf_5_4 = _mm256_permute2x128_si256(rnd_4_4, rnd_4_4, 0x01);
   __m256i shf_5_20 = _mm256_permute2x128_si256(rnd_4_20, rnd_4_20, 0x01);
   __m256i rnd_5_4 = _mm256_blendv_epi8(rnd_4_4, shf_5_20, blm_5);
   __m256i rnd_5_20 = _mm256_blendv_epi8(shf_5_4, rnd_4_20, blm_5);
-  *(__m256i*)(dst_origin + 4*dst_stride) = rnd_5_4;
-  *(__m256i*)(dst_origin + 20*dst_stride) = rnd_5_20;
+  _mm256_storeu_si256((__m256i*)(dst_origin + 4*dst_stride), rnd_5_4);
+  _mm256_storeu_si256((__m256i*)(dst_origin + 20*dst_stride), rnd_5_20);
   __m256i shf_5_5 = _mm256_permute2x128_si256(rnd_4_5, rnd_4_5, 0x01);
   __m256i shf_5_21 = _mm256_permute2x128_si256(rnd_4_21, rnd_4_21, 0x01);
   __m256i rnd_5_5 = _mm256_blendv_epi8(rnd_4_5, shf_5_21, blm_5);
   __m256i rnd_5_21 = _mm256_blendv_epi8(shf_5_5, rnd_4_21, blm_5);
-  *(__m256i*)(dst_origin + 5*dst_stride) = rnd_5_5;
-  *(__m256i*)(dst_origin + 21*dst_stride) = rnd_5_21;
+  _mm256_storeu_si256((__m256i*)(dst_origin + 5*dst_stride), rnd_5_5);
+  _mm256_storeu_si256((__m256i*)(dst_origin + 21*dst_stride), rnd_5_21);
   __m256i shf_5_6 = _mm256_permute2x128_si256(rnd_4_6, rnd_4_6, 0x01);
   __m256i shf_5_22 = _mm256_permute2x128_si256(rnd_4_22, rnd_4_22, 0x01);
   __m256i rnd_5_6 = _mm256_blendv_epi8(rnd_4_6, shf_5_22, blm_5);
   _mm_prefetch(prf_origin+13*src_stride, _MM_HINT_NTA);
   __m256i rnd_5_22 = _mm256_blendv_epi8(shf_5_6, rnd_4_22, blm_5);
-  *(__m256i*)(dst_origin + 6*dst_stride) = rnd_5_6;
-  *(__m256i*)(dst_origin + 22*dst_stride) = rnd_5_22;
+  _mm256_storeu_si256((__m256i*)(dst_origin + 6*dst_stride), rnd_5_6);
+  _mm256_storeu_si256((__m256i*)(dst_origin + 22*dst_stride), rnd_5_22);
   __m256i shf_5_7 = _mm256_permute2x128_si256(rnd_4_7, rnd_4_7, 0x01);
   __m256i shf_5_23 = _mm256_permute2x128_si256(rnd_4_23, rnd_4_23, 0x01);
   __m256i rnd_5_7 = _mm256_blendv_epi8(rnd_4_7, shf_5_23, blm_5);
   __m256i rnd_5_23 = _mm256_blendv_epi8(shf_5_7, rnd_4_23, blm_5);
-  *(__m256i*)(dst_origin + 7*dst_stride) = rnd_5_7;
-  *(__m256i*)(dst_origin + 23*dst_stride) = rnd_5_23;
+  _mm256_storeu_si256((__m256i*)(dst_origin + 7*dst_stride), rnd_5_7);
+  _mm256_storeu_si256((__m256i*)(dst_origin + 23*dst_stride), rnd_5_23);
   __m256i shf_5_8 = _mm256_permute2x128_si256(rnd_4_8, rnd_4_8, 0x01);
   __m256i shf_5_24 = _mm256_permute2x128_si256(rnd_4_24, rnd_4_24, 0x01);
   __m256i rnd_5_8 = _mm256_blendv_epi8(rnd_4_8, shf_5_24, blm_5);
   __m256i rnd_5_24 = _mm256_blendv_epi8(shf_5_8, rnd_4_24, blm_5);
-  *(__m256i*)(dst_origin + 8*dst_stride) = rnd_5_8;
-  *(__m256i*)(dst_origin + 24*dst_stride) = rnd_5_24;
+  _mm256_storeu_si256((__m256i*)(dst_origin + 8*dst_stride), rnd_5_8);
+  _mm256_storeu_si256((__m256i*)(dst_origin + 24*dst_stride), rnd_5_24);
   __m256i shf_5_9 = _mm256_permute2x128_si256(rnd_4_9, rnd_4_9, 0x01);
   __m256i shf_5_25 = _mm256_permute2x128_si256(rnd_4_25, rnd_4_25, 0x01);
   __m256i rnd_5_9 = _mm256_blendv_epi8(rnd_4_9, shf_5_25, blm_5);
   __m256i rnd_5_25 = _mm256_blendv_epi8(shf_5_9, rnd_4_25, blm_5);
-  *(__m256i*)(dst_origin + 9*dst_stride) = rnd_5_9;
-  *(__m256i*)(dst_origin + 25*dst_stride) = rnd_5_25;
+  _mm256_storeu_si256((__m256i*)(dst_origin + 9*dst_stride), rnd_5_9);
+  _mm256_storeu_si256((__m256i*)(dst_origin + 25*dst_stride), rnd_5_25);
   __m256i shf_5_10 = _mm256_permute2x128_si256(rnd_4_10, rnd_4_10, 0x01);
   __m256i shf_5_26 = _mm256_permute2x128_si256(rnd_4_26, rnd_4_26, 0x01);
   __m256i rnd_5_10 = _mm256_blendv_epi8(rnd_4_10, shf_5_26, blm_5);
   _mm_prefetch(prf_origin+14*src_stride, _MM_HINT_NTA);
   __m256i rnd_5_26 = _mm256_blendv_epi8(shf_5_10, rnd_4_26, blm_5);
-  *(__m256i*)(dst_origin + 10*dst_stride) = rnd_5_10;
-  *(__m256i*)(dst_origin + 26*dst_stride) = rnd_5_26;
+  _mm256_storeu_si256((__m256i*)(dst_origin + 10*dst_stride), rnd_5_10);
+  _mm256_storeu_si256((__m256i*)(dst_origin + 26*dst_stride), rnd_5_26);
   __m256i shf_5_11 = _mm256_permute2x128_si256(rnd_4_11, rnd_4_11, 0x01);
   __m256i shf_5_27 = _mm256_permute2x128_si256(rnd_4_27, rnd_4_27, 0x01);
   __m256i rnd_5_11 = _mm256_blendv_epi8(rnd_4_11, shf_5_27, blm_5);
   __m256i rnd_5_27 = _mm256_blendv_epi8(shf_5_11, rnd_4_27, blm_5);
-  *(__m256i*)(dst_origin + 11*dst_stride) = rnd_5_11;
-  *(__m256i*)(dst_origin + 27*dst_stride) = rnd_5_27;
+  _mm256_storeu_si256((__m256i*)(dst_origin + 11*dst_stride), rnd_5_11);
+  _mm256_storeu_si256((__m256i*)(dst_origin + 27*dst_stride), rnd_5_27);
   __m256i shf_5_12 = _mm256_permute2x128_si256(rnd_4_12, rnd_4_12, 0x01);
   __m256i shf_5_28 = _mm256_permute2x128_si256(rnd_4_28, rnd_4_28, 0x01);
   __m256i rnd_5_12 = _mm256_blendv_epi8(rnd_4_12, shf_5_28, blm_5);
   __m256i rnd_5_28 = _mm256_blendv_epi8(shf_5_12, rnd_4_28, blm_5);
-  *(__m256i*)(dst_origin + 12*dst_stride) = rnd_5_12;
-  *(__m256i*)(dst_origin + 28*dst_stride) = rnd_5_28;
+  _mm256_storeu_si256((__m256i*)(dst_origin + 12*dst_stride), rnd_5_12);
+  _mm256_storeu_si256((__m256i*)(dst_origin + 28*dst_stride), rnd_5_28);
   __m256i shf_5_13 = _mm256_permute2x128_si256(rnd_4_13, rnd_4_13, 0x01);
   __m256i shf_5_29 = _mm256_permute2x128_si256(rnd_4_29, rnd_4_29, 0x01);
   __m256i rnd_5_13 = _mm256_blendv_epi8(rnd_4_13, shf_5_29, blm_5);
   __m256i rnd_5_29 = _mm256_blendv_epi8(shf_5_13, rnd_4_29, blm_5);
-  *(__m256i*)(dst_origin + 13*dst_stride) = rnd_5_13;
-  *(__m256i*)(dst_origin + 29*dst_stride) = rnd_5_29;
+  _mm256_storeu_si256((__m256i*)(dst_origin + 13*dst_stride), rnd_5_13);
+  _mm256_storeu_si256((__m256i*)(dst_origin + 29*dst_stride), rnd_5_29);
   __m256i shf_5_14 = _mm256_permute2x128_si256(rnd_4_14, rnd_4_14, 0x01);
   __m256i shf_5_30 = _mm256_permute2x128_si256(rnd_4_30, rnd_4_30, 0x01);
   __m256i rnd_5_14 = _mm256_blendv_epi8(rnd_4_14, shf_5_30, blm_5);
   _mm_prefetch(prf_origin+15*src_stride, _MM_HINT_NTA);
   __m256i rnd_5_30 = _mm256_blendv_epi8(shf_5_14, rnd_4_30, blm_5);
-  *(__m256i*)(dst_origin + 14*dst_stride) = rnd_5_14;
-  *(__m256i*)(dst_origin + 30*dst_stride) = rnd_5_30;
+  _mm256_storeu_si256((__m256i*)(dst_origin + 14*dst_stride), rnd_5_14);
+  _mm256_storeu_si256((__m256i*)(dst_origin + 30*dst_stride), rnd_5_30);
   __m256i shf_5_15 = _mm256_permute2x128_si256(rnd_4_15, rnd_4_15, 0x01);
   __m256i shf_5_31 = _mm256_permute2x128_si256(rnd_4_31, rnd_4_31, 0x01);
   __m256i rnd_5_15 = _mm256_blendv_epi8(rnd_4_15, shf_5_31, blm_5);
   __m256i rnd_5_31 = _mm256_blendv_epi8(shf_5_15, rnd_4_31, blm_5);
-  *(__m256i*)(dst_origin + 15*dst_stride) = rnd_5_15;
-  *(__m256i*)(dst_origin + 31*dst_stride) = rnd_5_31;
+  _mm256_storeu_si256((__m256i*)(dst_origin + 15*dst_stride), rnd_5_15);
+  _mm256_storeu_si256((__m256i*)(dst_origin + 31*dst_stride), rnd_5_31);
 }
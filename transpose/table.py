@@ -2,30 +2,55 @@
 import re
 import os
 
-algos = ['Naive', 'Reverse', 'Blocks', 'BlocksPrf', 'Vec32', 'Vec64', 'Vec256', 'Vec256Buf']
+algos = ['Naive', 'Reverse', 'Blocks', 'BlocksPrf', 'Vec32', 'Vec64', 'Vec256', 'Vec256Buf', 'Vec256Vbmi', 'Vec512', 'Vec512Buf', 'Recursive', 'Tuned', 'InPlace']
+wide_algos = ['Naive', 'Reverse', 'Blocks', 'Vec256']
+padded_algos = ['Blocks', 'Vec256', 'Vec256Buf', 'Vec512', 'Vec512Buf', 'Recursive', 'InPlace']
 nn = list()
 results = dict()
+fallbacks = set() # results of another algorithm, "# ran as ..." in the result file
 
 for name in os.listdir('results'):
   with open(f'results/{name}', 'r') as fd:
     lines = fd.readlines()
+  key = None
   for line in lines:
+    if line.startswith('# ran as') and key is not None:
+      fallbacks.add(key)
+    if line.startswith('#'):
+      continue
     tokens = re.split(' +', line.strip())
-    algo, n, cpe, _ = tokens
-    n = int(n)
+    algo, n, cpe = tokens[:3] # n is either a size or a <rows>x<cols> shape
     cpe = float(cpe)
     if n not in nn:
       nn.append(n)
-    results[(algo,n)] = cpe
+    key = (algo, n)
+    results[key] = cpe
 
-nn.sort()
+# squares by size, then shapes by rows
+nn.sort(key=lambda n: (len(n.split('x')), [int(d) for d in n.split('x')]))
 
-print('|N|' + '|'.join(algos))
-for n in nn:
-  print(f'|*{n}*', end='')
-  for algo in algos:
-    res = results[(algo, n)]
-    print(f'|{res:.2f}', end='')
+def print_table(algos):
+  print('|N|' + '|'.join(algos))
+  for n in nn:
+    if not any((algo, n) in results for algo in algos):
+      continue
+    print(f'|*{n}*', end='')
+    for algo in algos:
+      res = results.get((algo, n))
+      mark = '*' if (algo, n) in fallbacks else ''
+      print(f'|{res:.2f}{mark}' if res is not None else '|-', end='')
+    print()
+
+print_table(algos)
+if fallbacks:
   print()
+  print('\\* fell back to another algorithm, e.g. Vec256 for a Buf variant when rows of dst are not aligned for streaming stores')
 
+# wider elements, one table per type
+for t in ['u16', 'u32', 'u64']:
+  print()
+  print_table([f'{algo}:{t}' for algo in wide_algos])
 
+# padded rows next to contiguous ones
+print()
+print_table([a for algo in padded_algos for a in (algo, f'{algo}:padded')])